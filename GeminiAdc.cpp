@@ -0,0 +1,153 @@
+/*
+   GeminiAdc.cpp - Background ADC sampler for the battery voltage and the temperature sensors.
+
+   The ADC runs free in interrupt mode through the channels of a round and is switched off in between.
+   After a channel change the first conversions are dropped: the one already under way reads the old channel,
+   and a reference change needs the AREF capacitor to settle. Then 4^ADC_OVERSAMPLE_BITS samples are summed and
+   decimated to ADC_RESULT_BITS, and the result goes through a first order low pass filter.
+   Readers get the filtered value straight away, without waiting for a conversion.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include "GeminiAdc.h"
+
+#define ADC_SAMPLES        (1 << (2 * ADC_OVERSAMPLE_BITS))
+#define ADC_MUX_SETTLE     2      // Conversions dropped after a channel change
+#define ADC_REF_SETTLE     200    // Conversions dropped after a reference change, about 20 ms
+#define ADC_ROUND_MAX_MS   200    // adc_begin() gives up waiting after this
+
+#define ADC_REF_MASK       (_BV(REFS1) | _BV(REFS0))
+#define ADC_REF_AVCC       _BV(REFS0)
+#define ADC_REF_1V1        (_BV(REFS1) | _BV(REFS0))
+
+// ADC clock within 50-200 kHz
+#if F_CPU > 12000000L
+  #define ADC_PRESCALER    (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))   // 128
+#else
+  #define ADC_PRESCALER    (_BV(ADPS2) | _BV(ADPS1))                // 64, 125 kHz at 8 MHz
+#endif
+
+static_assert(ADC_OVERSAMPLE_BITS <= 3, "The sum of the samples must fit 16 bits");
+static_assert(ADC_RESULT_BITS + ADC_FILTER_SHIFT <= 16, "The filtered value must fit 16 bits");
+
+static const uint8_t g_adc_admux[ADC_CHANNELS] = {
+  ADC_REF_AVCC | (Vpwerbus - A0),
+#if defined (TMP36_TEMP_SENSOR_PRESENT)
+  ADC_REF_AVCC | (TMP36_PIN - A0),
+#endif
+  ADC_REF_1V1 | _BV(MUX3)
+};
+
+static volatile uint16_t g_adc_filtered[ADC_CHANNELS];   // ADC_FILTER_SHIFT fraction bits
+static volatile uint8_t g_adc_valid = 0;                 // Channels with a first reading
+static volatile bool g_adc_busy = false;
+static volatile uint8_t g_adc_channel;
+static volatile uint8_t g_adc_discard;
+static volatile uint8_t g_adc_count;
+static volatile uint16_t g_adc_sum;
+static unsigned long g_adc_round_ms = 0;
+
+static void adc_select(uint8_t channel) {
+  g_adc_discard = ((ADMUX ^ g_adc_admux[channel]) & ADC_REF_MASK) ? ADC_REF_SETTLE : ADC_MUX_SETTLE;
+  g_adc_channel = channel;
+  g_adc_count = 0;
+  g_adc_sum = 0;
+  ADMUX = g_adc_admux[channel]; // From the next conversion on
+}
+
+ISR(ADC_vect) {
+  uint16_t sample = ADC;
+  uint16_t reading;
+  uint8_t channel = g_adc_channel;
+
+  if (!g_adc_busy) return; // The conversion under way when the round ended
+
+  if (g_adc_discard > 0) {
+    g_adc_discard--;
+    return;
+  }
+
+  g_adc_sum += sample;
+  if (++g_adc_count < ADC_SAMPLES) return;
+
+  // Decimate, the sum of 4^n samples shifted right by n has n more bits
+  reading = g_adc_sum >> ADC_OVERSAMPLE_BITS;
+
+  if (g_adc_valid & _BV(channel)) {
+    g_adc_filtered[channel] += ((int32_t)((uint32_t)reading << ADC_FILTER_SHIFT) - g_adc_filtered[channel]) >> ADC_FILTER_SHIFT;
+  }
+  else {
+    g_adc_filtered[channel] = reading << ADC_FILTER_SHIFT;
+    g_adc_valid |= _BV(channel);
+  }
+
+  if (channel + 1 < ADC_CHANNELS) {
+    adc_select(channel + 1);
+  }
+  else {
+    ADCSRA = 0; // ADC off until the next round
+    g_adc_busy = false;
+  }
+}
+
+static void adc_start_round() {
+  g_adc_round_ms = millis();
+  g_adc_busy = true;
+  adc_select(0);
+  ADCSRB = 0; // Free running
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | ADC_PRESCALER;
+}
+
+void adc_begin() {
+  uint8_t i;
+
+  // No digital input buffers on the analog inputs we sample
+  for (i = 0; i < ADC_CHANNELS; i++) {
+    if (g_adc_admux[i] & _BV(MUX3)) continue; // Internal
+#if defined (DS1820_TEMP_SENSOR_PRESENT)
+    if ((g_adc_admux[i] & 0x07) == ONE_WIRE_BUS - A0) continue; // Shared with the One-Wire bus, keep it digital
+#endif
+    DIDR0 |= _BV(g_adc_admux[i] & 0x07);
+  }
+
+  adc_start_round();
+  while (g_adc_busy && (millis() - g_adc_round_ms < ADC_ROUND_MAX_MS));
+}
+
+void adc_poll() {
+  if (!g_adc_busy && (millis() - g_adc_round_ms >= ADC_SAMPLE_INTERVAL_MS)) adc_start_round();
+
+#if defined (ADC_IDLE_SLEEP)
+  // Timers and serial carry on, the end of a conversion or any other interrupt wakes us up
+  if (g_adc_busy) {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+  }
+#endif
+}
+
+uint16_t adc_value(uint8_t channel) {
+  uint16_t value;
+
+  noInterrupts();
+    value = g_adc_filtered[channel];
+  interrupts();
+
+  return (value + (1 << ADC_FILTER_SHIFT) / 2) >> ADC_FILTER_SHIFT;
+}
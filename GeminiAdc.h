@@ -0,0 +1,41 @@
+#ifndef GEMINIADC_H
+#define GEMINIADC_H
+/*
+   GeminiAdc.h - Definitions for the background ADC sampler
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiXConfig.h"
+#include "GeminiBoardConfig.h"
+
+#define ADC_RESULT_BITS   (10 + ADC_OVERSAMPLE_BITS)
+#define ADC_FULL_SCALE    (1L << ADC_RESULT_BITS)   // Reading of the reference voltage
+
+enum AdcChannel {
+  ADC_CH_BATTERY,       // Vpwerbus on the AVcc reference
+#if defined (TMP36_TEMP_SENSOR_PRESENT)
+  ADC_CH_TMP36,         // TMP36_PIN on the AVcc reference
+#endif
+  ADC_CH_PROCESSOR,     // Internal temperature sensor on the 1.1 V reference
+  ADC_CHANNELS
+};
+
+void adc_begin();                      // Returns once every channel has a reading
+void adc_poll();                       // From loop(), starts a round every ADC_SAMPLE_INTERVAL_MS
+uint16_t adc_value(uint8_t channel);   // Filtered reading, ADC_RESULT_BITS bits
+#endif
@@ -44,6 +44,11 @@
 // This must be defined if the GPS PPS PIN is connected to D2 or D3, otherwise commented out
 #define GPS_PPS_ON_D2_OR_D3        //GPS PPS connects to D2 or D3 and thus can use an External Interrupt othwerwise 
 
+// Alternatively the PPS can be wired to D8 (ICP1), the Timer1 input capture pin. Timer1 then latches the
+// calibration count on the PPS edge in hardware so the measurement doesn't depend on interrupt latency,
+// which allows much shorter calibration gates. Define this instead of GPS_PPS_ON_D2_OR_D3 and set GPS_PPS_PIN to 8.
+//#define GPS_PPS_ON_ICP1
+
 // K1FM 1.2 boards and greater support the ability to enable/disable VCC power to GPS  
 #define GPS_POWER_DISABLE_SUPPORTED
 
@@ -173,4 +178,12 @@ Arduino Hardware Pin Configurations - change these to match your specific hardwa
 // On some GPS units, this is necessary in order to unlock posiotion fixes above 10K meters altitude
 #define GPS_BALLOON_MODE_COMMAND "$PMTK886,3*2B\r\n"
 
+/**************************************************************************************
+   GPS RECEIVER FAMILY
+ **************************************************************************************/
+// Selects the command set used at startup to disable the NMEA sentences that NeoGPS does not use
+// and to set the fix rate. Define only one. If neither is defined the receiver is left at its defaults.
+#define GPS_RECEIVER_MTK                       // MediaTek based receivers (PMTK314/PMTK220)
+//#define GPS_RECEIVER_UBLOX                   // u-blox based receivers (UBX CFG-MSG/CFG-RATE)
+
 #endif
\ No newline at end of file
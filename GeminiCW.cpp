@@ -64,7 +64,7 @@ char morsetab[] = {
   106,// .
   76, // ?
   41, // '/'
-  193 // '-'
+  (char)193 // '-', above CHAR_MAX where char is signed
 };
 
 #define N_MORSE  (sizeof(morsetab)/sizeof(morsetab[0]))
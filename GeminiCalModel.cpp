@@ -0,0 +1,94 @@
+/*
+   GeminiCalModel.cpp - Temperature model of the Si5351 correction.
+
+   The Si5351 reference crystal drifts with temperature and a balloon sees anything from +30 C to -50 C.
+   Each successful calibration is stored against the temperature it was made at, in buckets of
+   CAL_MODEL_BUCKET_C degrees. The correction for the current temperature can then be applied ahead of each
+   slot without measuring, and a full calibration is only needed for temperatures we have no data for or
+   when a measurement disagrees with the model.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiCalModel.h"
+#include "GeminiSerialMonitor.h"
+
+static struct CalModelEntry g_cal_model[CAL_MODEL_BUCKETS];
+
+// Bucket for a temperature, temperatures beyond the table use the first or last bucket
+static uint8_t cal_model_bucket(int temperature_c) {
+  int bucket;
+
+  if (temperature_c < CAL_MODEL_MIN_C) return 0;
+  bucket = (temperature_c - CAL_MODEL_MIN_C) / CAL_MODEL_BUCKET_C;
+  if (bucket >= CAL_MODEL_BUCKETS) bucket = CAL_MODEL_BUCKETS - 1;
+  return bucket;
+}
+
+void cal_model_clear() {
+  uint8_t i;
+
+  for (i = 0; i < CAL_MODEL_BUCKETS; i++) {
+    g_cal_model[i].correction = 0;
+    g_cal_model[i].samples = 0;
+  }
+}
+
+void cal_model_update(int temperature_c, int32_t correction) {
+  struct CalModelEntry *entry = &g_cal_model[cal_model_bucket(temperature_c)];
+  uint8_t weight;
+
+  if ((entry->samples == 0) || (abs(correction - entry->correction) > CAL_MODEL_TOLERANCE_PPB)) {
+    // No data yet, or the crystal has moved on (aging, or the entry was wrong) so start again from here
+    entry->correction = correction;
+    entry->samples = 1;
+    return;
+  }
+
+  // Running mean, with a floor on the weight of a new value so the entry keeps tracking slow aging
+  weight = (entry->samples < CAL_MODEL_MAX_WEIGHT) ? entry->samples + 1 : CAL_MODEL_MAX_WEIGHT;
+  entry->correction += (correction - entry->correction) / weight;
+  if (entry->samples < 255) entry->samples++;
+}
+
+bool cal_model_lookup(int temperature_c, int32_t *correction) {
+  struct CalModelEntry *entry = &g_cal_model[cal_model_bucket(temperature_c)];
+
+  if (entry->samples == 0) return false;
+  *correction = entry->correction;
+  return true;
+}
+
+void cal_model_get(struct CalModelEntry *table) {
+  memcpy(table, g_cal_model, sizeof(g_cal_model));
+}
+
+void cal_model_set(const struct CalModelEntry *table) {
+  memcpy(g_cal_model, table, sizeof(g_cal_model));
+}
+
+void cal_model_dump() {
+  char msg[40];
+  uint8_t i;
+
+  for (i = 0; i < CAL_MODEL_BUCKETS; i++) {
+    if (g_cal_model[i].samples == 0) continue;
+    sprintf(msg, "Cal model %dC corr:%ld n:%u", CAL_MODEL_MIN_C + i * CAL_MODEL_BUCKET_C,
+            (long)g_cal_model[i].correction, g_cal_model[i].samples);
+    gemini_log(msg);
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef GEMINICALMODEL_H
+#define GEMINICALMODEL_H
+/*
+   GeminiCalModel.h - Definitions for the temperature model of the Si5351 correction
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiXConfig.h"
+
+#define CAL_MODEL_MAX_WEIGHT  8     // A new calibration moves an entry by at least 1/8 of the difference
+
+struct CalModelEntry {
+  int32_t correction;   // Si5351 correction in ppb
+  uint8_t samples;      // Calibrations behind the entry, 0 = no data for this bucket
+};
+
+// Forget everything learned so far
+void cal_model_clear();
+
+// Record the correction found by a successful calibration at temperature_c
+void cal_model_update(int temperature_c, int32_t correction);
+
+// Correction for temperature_c. Returns false if the model has no data for that temperature.
+bool cal_model_lookup(int temperature_c, int32_t *correction);
+
+// Copy the whole table out and back in, CAL_MODEL_BUCKETS entries, for persistence
+void cal_model_get(struct CalModelEntry *table);
+void cal_model_set(const struct CalModelEntry *table);
+
+// Dump the populated buckets through the serial monitor
+void cal_model_dump();
+#endif
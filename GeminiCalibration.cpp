@@ -12,9 +12,21 @@
    clock period in order for it to reliably generate an interrupt. We divide by 2.5 for a safety margin.
    That yields a calibration frequency of 3.2 Mhz for an assumed 8Mhz clock.
 
-   Frequency sampling is done for 10 seonds to achieve a 1/10 Hz resolution.
-   After each 10 second sample a frequency correction factor is applied using a Huff&Puff algorithm.
-   Each calibration cycle samples and corrects for 24 iterations so takes approximately 4 minutes.
+   Timer1 is never stopped or reset to open and close a gate. Instead the 32 bit count is timestamped on each
+   PPS edge and the gate is the difference between two timestamps, so the constant part of the interrupt
+   latency cancels out. With the PPS on D8 (GPS_PPS_ON_ICP1) the input capture unit latches the count in
+   hardware and the latency doesn't matter at all.
+
+   A gate of N seconds resolves 1/N Hz. Calibration measures pairs of gates, short while the error is large and
+   doubling the gate as the error shrinks, up to CALIBRATION_GATE_MAX_S. The difference between the two gates of a
+   pair is the noise floor, one count at least: without the input capture unit the interrupt latency jitter is
+   larger than the counting, and a pair that disagrees because another ISR held off the PPS is measured again.
+   The correction is computed directly in parts per billion from the mean error of the pair and applied in one
+   step. Calibration stops as soon as the worst case residual (mean error plus noise floor) is below
+   CALIBRATION_STOP_RESIDUAL_CHZ at the TX frequency, and gives up after CALIBRATION_MAX_S, less than a WSPR slot.
+   Only when even the longest gate can't resolve the error do we fall back to nudging the correction by a fixed
+   fine step (Huff&Puff), which averages out the counting quantization from one calibration to the next.
+   tools/gate_sim simulates the whole calibration for choosing CALIBRATION_STOP_RESIDUAL_CHZ.
 
    Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
    Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
@@ -35,6 +47,9 @@
 #include "GeminiBoardConfig.h"
 #include "GeminiSi5351.h"
 #include "GeminiCalibration.h"
+#include "GeminiCalModel.h"
+#include "GeminiPark.h"
+#include <TimeLib.h>
 #include "GeminiSerialMonitor.h"
 
 
@@ -47,7 +62,45 @@ uint64_t target_freq = SI5351_CAL_TARGET_FREQ  // 3.20 MHz, in hundredths of her
 volatile unsigned int overflowCounter = 0;
 volatile unsigned int gpsPPScounter = 0;
 volatile bool g_calibration_proceed = false;
+volatile unsigned int g_gate_seconds = CALIBRATION_GATE_S;  // Length of the counting gate in PPS seconds
 volatile bool is_PPS_rising_edge = false; 
+volatile bool g_calibration_armed = false;        // The PPS interrupt only gates the counter while this is set
+volatile unsigned long g_pps_edge_count = 0;      // Free running count of PPS edges for the GPS health metrics
+
+#if defined (GPS_PPS_ON_ICP1) && defined (GPS_PPS_ON_D2_OR_D3)
+#error "Define only one of GPS_PPS_ON_ICP1 and GPS_PPS_ON_D2_OR_D3"
+#endif
+
+#if defined (TX_FREQ_MONITOR) && !SI5351_SELF_CALIBRATION_SUPPORTED
+#error "TX_FREQ_MONITOR needs the calibration clock fed back to D5"
+#endif
+
+// Timer1 configuration to count the calibration clock on T1 (D5), rising edge. With input capture we also
+// latch TCNT1 into ICR1 on the rising edge of ICP1 (D8), with the noise canceler on (a constant 4 cycle delay).
+#if defined (GPS_PPS_ON_ICP1)
+#define TIMER1_COUNTER_TCCR1B  ((1 << CS12) | (1 << CS11) | (1 << CS10) | (1 << ICNC1) | (1 << ICES1))
+#define TIMER1_COUNTER_TIMSK1  ((1 << TOIE1) | (1 << ICIE1))
+#else
+#define TIMER1_COUNTER_TCCR1B  ((1 << CS12) | (1 << CS11) | (1 << CS10))
+#define TIMER1_COUNTER_TIMSK1  (1 << TOIE1)
+#endif
+
+volatile unsigned long g_gate_start_stamp = 0;    // Timer1 count at the PPS edge opening the gate
+volatile unsigned long g_gate_end_stamp = 0;      // and closing it
+volatile unsigned long g_pps_last_stamp = 0;      // Timer1 count at the latest PPS edge, for the background service
+volatile unsigned long g_pps_last_us = 0;         // micros() at the latest PPS edge, for the processor clock error
+
+// Background service, see cal_service_poll()
+static bool g_cal_service_running = false;
+static bool g_cal_bg_have_stamp = false;          // g_cal_bg_last_stamp is a valid reference
+static uint8_t g_cal_bg_settle = 0;               // PPS intervals still to be ignored after the clock was (re)started
+static unsigned long g_cal_bg_last_edges = 0;
+static unsigned long g_cal_bg_last_stamp = 0;
+static int32_t g_cal_bg_gate_residual = 0;        // Counts above nominal in the gate being accumulated
+static uint16_t g_cal_bg_gate_seconds = 0;
+static int32_t g_cal_bg_residual = 0;             // Counts above nominal behind the running estimate
+static uint16_t g_cal_bg_seconds = 0;
+static uint8_t g_cal_bg_outliers = 0;             // Consecutive gates disagreeing with the running estimate
 
 // Timer1 is our counter
 // 16-bit counter overflows after 65536 counts
@@ -60,29 +113,55 @@ ISR(TIMER1_OVF_vect) // Interrupt handler for Timer1 overflow. This is invoked w
   overflowCounter++;
 }
 
+// Extend a 16 bit Timer1 count latched in an ISR to 32 bits with overflowCounter.
+// If TOV1 is still pending the overflow hasn't been counted yet, it belongs to this count if the count is low.
+static inline unsigned long timer1_stamp(uint16_t count)
+{
+  unsigned int overflows = overflowCounter;
+
+  if ((TIFR1 & (1 << TOV1)) && (count < 0x8000)) overflows++;
+  return ((unsigned long)overflows << 16) | count;
+}
+
+// Called on every PPS rising edge with the Timer1 count at the edge
+static inline void pps_edge(unsigned long stamp)
+{
+  g_pps_edge_count++;
+  g_pps_last_stamp = stamp;
+  g_pps_last_us = micros();
+
+  if (!g_calibration_armed) return;
+
+  gpsPPScounter++;
+
+  if (gpsPPScounter == 1) {
+    // First PPS pulse received after the gate was armed
+    g_gate_start_stamp = stamp;
+  }
+
+  if (gpsPPScounter == g_gate_seconds + 1) { // End of the gate
+    g_gate_end_stamp = stamp;
+    g_calibration_armed = false; // Stop gating, the PPS interrupt itself stays enabled to count edges
+
+    // We have completed the gate, this triggers the frequency calculation on RTI
+    g_calibration_proceed = true;
+  }
+}
+
 // Conditional compilation for GPS PPS interrupt handler
-#if defined GPS_PPS_ON_D2_OR_D3
+#if defined (GPS_PPS_ON_ICP1)
+  // Input capture on D8, ICR1 holds the count at the exact PPS edge
+  ISR(TIMER1_CAPT_vect)
+  {
+    pps_edge(timer1_stamp(ICR1));
+  }
+#elif defined GPS_PPS_ON_D2_OR_D3
   // Interrupt Handler for GPS PPS signal using External Interrupts on D2 or D3
   void PPSinterruptISR()
   {
-   gpsPPScounter++;
-
-   if (gpsPPScounter == 1 ) {
-     // First PPS pulse received after interrupt enabled
-     // enable Frequency counting
-     TCNT1  = 0; // Initialize Timer1 counter to 0.
-     TIFR1 = (1 << TOV1); //Clear overlow flag in case it is set
-     overflowCounter = 0;
-   }
-
-    if (gpsPPScounter == 11) { // Ten seconds of counting
-     EIMSK = (0 << INT0); // Disable GPS PPS external interrupt (INT1 on PIN D3)- CHANGE THIS to "INT0" IF USING PIN D2
-     TCCR1B = 0; // Disable Timer1 Counter
-
-     // We have completed 10 seconds of sampling, this triggers the frequency calculation on RTI
-     g_calibration_proceed = true;
-    }
+    uint16_t count = TCNT1; // First thing, the latency up to here is constant and cancels out in the gate
 
+    pps_edge(timer1_stamp(count));
   } // end PPSInterruptISR
 #else
   // Interrupt Handler for GPS PPS signal using PinChangeInterrupts on A5/PCINT13 typical of U3S clone boards
@@ -95,6 +174,8 @@ ISR(TIMER1_OVF_vect) // Interrupt handler for Timer1 overflow. This is invoked w
   //  A5 uses  PCINT1_vect as an ISR and PCINT13 (PCMSK1 / PCIF1 / PCIE1) 
   ISR (PCINT1_vect) // handle pin change interrupt for A0 to A5 here. This will need modification for use with other pins.
   {
+    uint16_t count = TCNT1; // First thing, the latency up to here is constant and cancels out in the gate
+
     // PinChange Interrupts don't support triggering on leading or trailing edge (they trigger on both) so we mimic
     // this external interrupt functionality by ignoring every second trigger. 
     // We assume the first pulse is rising and just keep toggling the state back and forth each time the ISR is called,
@@ -103,26 +184,7 @@ ISR(TIMER1_OVF_vect) // Interrupt handler for Timer1 overflow. This is invoked w
    is_PPS_rising_edge = !is_PPS_rising_edge; // toggle the rising edge boolean flag
    
    if (is_PPS_rising_edge == true ) {
-    
-    gpsPPScounter++;
-
-    if (gpsPPScounter == 1 ) {
-      // First PPS pulse received after interrupt enabled
-     // enable Frequency counting
-     TCNT1  = 0; // Initialize Timer1 counter to 0.
-     TIFR1 = (1 << TOV1); //Clear TImer1 overlow flag in case it is set
-     overflowCounter = 0;
-    }
-
-    if (gpsPPScounter == 11) { // Ten seconds of counting
-     PCMSK1 = (0 << PCINT13); // Disable PinChangeInterrupts (GPS PPS interrupt PCINT13 on A5)
-     TCCR1B = 0; // Disable Timer1 Counter
-     is_PPS_rising_edge = false; 
-
-     // We have completed 10 seconds of sampling, this triggers the frequency calculation on RTI
-     g_calibration_proceed = true;
-    }
-
+    pps_edge(timer1_stamp(count));
    } // end if (is_PPS_rising_edge)
 
   }  // end of PCINT1_vect
@@ -146,49 +208,40 @@ void reset_for_calibration()
 
     // TCCR1B CS12 =1, CS11=1, CS10=1 means select external clock source on T1 PIN (D5), trigger on rising edge
     // of Si5351 Calibration CLK signal
-    TCCR1B = (1 << CS12) | (1 << CS11) | (1 << CS10);
+    TCCR1B = TIMER1_COUNTER_TCCR1B;
 
     // Enable Timer1 overflow interrupt - will jump into ISR(TIMER1_OVF_vect) when TOV1 is set
-    TIMSK1 = (1 << TOIE1); // Enable Timer1 Overflow Interrupt for now
+    TIMSK1 = TIMER1_COUNTER_TIMSK1; // Enable Timer1 Overflow Interrupt for now
   interrupts();
 
   // Turn off the PARK clock
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  park_off();
 
   // Start Calibration clock on target frequency
   si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq);
 }
 
-// This initializes both of the Interrupts needed for self-calibration.
-void setup_calibration()
-{
-
-  // Timer1 Interrupt
-  // Timer1 (16 bits) is setup as a frequency counter to sample the Calibration clock
-  // Maximum frequency is Fclk_io/2 as sampled pulse duration must be larger than processor clock period(recommended to be < Fclk_io/2.5)
-  // Fclk_io is 8 MHz so we are using 3.2 Mhz as the calibration frequency for CAL_CLOCK_NUM
+// Timer1 as the calibration counter, the count runs on from wherever it is
+static void timer1_counter_begin() {
   noInterrupts();
-    // Select Normal mode, TCNT1 increments to a max of 0XFFFF, overflows to zero and sets TOV1 (Timer1 overflow flag)
-    // Note that the TOV1 flag is automatically reset to 0 by the Timer1 ISR
-   TCCR1A = 0;
-
-    TCNT1  = 0; // Initialize Timer1 counter to 0.
-
-    // TCCR1B CS12 =1, CS11=1, CS10=1 means select external clock source on T1 PIN (D5), trigger on rising edge
-    // of Si5351 Calibration CLK signal
-    TCCR1B = (1 << CS12) | (1 << CS11) | (1 << CS10);
-
-    // Enable Timer1 overflow interrupt - will jump into ISR(TIMER1_OVF_vect) when TOV1 is set
-    TIMSK1 = (1 << TOIE1); // Enable Timer1 Overflow Interrupt
+    TCCR1A = 0;
+    TCCR1B = TIMER1_COUNTER_TCCR1B;
+    TIFR1 = (1 << ICF1) | (1 << TOV1);
+    TIMSK1 = TIMER1_COUNTER_TIMSK1;
   interrupts();
+}
 
-#if defined (GPS_PPS_ON_D2_OR_D3) 
+// Enable the GPS PPS interrupt. It stays enabled from now on, counting edges for the GPS health metrics.
+// Calibration only arms it (g_calibration_armed) to open and close its counting gates.
+void pps_begin()
+{
+#if defined (GPS_PPS_ON_ICP1)
+  // The capture unit only works while Timer1 is configured as our counter, so this is also called to
+  // hand Timer1 back after it has been used as the WSPR symbol timer.
+  timer1_counter_begin();
+#elif defined (GPS_PPS_ON_D2_OR_D3) 
   // Set 1PPS pin D2 or D3 for external interrupt input
   attachInterrupt(digitalPinToInterrupt(GPS_PPS_PIN), PPSinterruptISR, RISING);
-
-  noInterrupts();
-    EIMSK = (0 << INT0); // Disable GPS PPS external interupt or now (INT1 on PIN D3) - CHANGE THIS TO "INT0" IF USING PIN D2
-  interrupts();
 #else
   // We are using PIN Change Interrupts. This will require reconfiguration if using other than Atmega PIN A5 to connect to the GPS PPS PIN
   /* Atmega328p Pin to PinChange Interrupt Register Mappings
@@ -217,95 +270,783 @@ void setup_calibration()
     // We are using A5 for GPS_PPS_PIN so PCINT13 (PCMSK1 / PCIF1 / PCIE1)
    PCICR |= (1 << PCIE1);    // [Pin Change Interrupt Control Register] - Enable PinchangeInterrupts for Port C (A5), without disabling PCIE0 or PCIE2
    PCIFR  = (1 << PCIF1);   // [Pin Change Interrupt Flag Register] clear any outstanding interrupts. Counterintuitively writing a 1 clears the flag
-   PCMSK1 = (0 << PCINT13); // [Pin Change Mask Register 1] Disable Interrupts for PCINT13 aka PIN A5. 
+   PCMSK1 |= (1 << PCINT13); // [Pin Change Mask Register 1] Enable Interrupts for PCINT13 aka PIN A5
    is_PPS_rising_edge = false; // Reset our toggle so we can mimic triggering only on rising edge
   interrupts();
 #endif
+}
+
+unsigned long pps_edge_count()
+{
+  unsigned long count;
+
+  noInterrupts();
+    count = g_pps_edge_count;
+  interrupts();
+  return count;
+}
+
+// This initializes the Timer1 counter needed for self-calibration. The PPS interrupt is set up by pps_begin().
+void setup_calibration()
+{
+
+  // Timer1 Interrupt
+  // Timer1 (16 bits) is setup as a frequency counter to sample the Calibration clock
+  // Maximum frequency is Fclk_io/2 as sampled pulse duration must be larger than processor clock period(recommended to be < Fclk_io/2.5)
+  // Fclk_io is 8 MHz so we are using 3.2 Mhz as the calibration frequency for CAL_CLOCK_NUM
+  noInterrupts();
+    // Select Normal mode, TCNT1 increments to a max of 0XFFFF, overflows to zero and sets TOV1 (Timer1 overflow flag)
+    // Note that the TOV1 flag is automatically reset to 0 by the Timer1 ISR
+   TCCR1A = 0;
 
+    TCNT1  = 0; // Initialize Timer1 counter to 0.
+
+    // TCCR1B CS12 =1, CS11=1, CS10=1 means select external clock source on T1 PIN (D5), trigger on rising edge
+    // of Si5351 Calibration CLK signal
+    TCCR1B = TIMER1_COUNTER_TCCR1B;
+
+    // Enable Timer1 overflow interrupt - will jump into ISR(TIMER1_OVF_vect) when TOV1 is set
+    TIMSK1 = TIMER1_COUNTER_TIMSK1; // Enable Timer1 Overflow Interrupt
+  interrupts();
 
   // Turn off the PARK clock
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  park_off();
 
   // Start Calibration clock on target frequency
   si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq);
 }
 
-void do_calibration(unsigned long calibration_step) {
-  byte i;
-  int timer_counter1 = 0;
+static bool g_gate_timed_out = false;   // The last gate didn't see enough PPS edges
 
-gemini_log("*** Starting Calibration ***");
+// Count the calibration clock over gate_s PPS seconds. Returns the frequency in hundredths of Hz,
+// 0 if the PPS edges didn't come (g_gate_timed_out) or nothing was counted.
+static uint64_t measure_cal_freq(uint8_t gate_s) {
+  unsigned long count;
+  unsigned long start_ms = millis();
 
-  // We do 24 frequency samples at 10 seconds each ( ~ 4 minutes) so the maximum correction is 24 X calibration_step
-  for (i = 0; i < 10; i++) {
+  // Arm the GPS PPS interrupt, the PPS interrupt handler timestamps the first PPS pulse
+  // and the one gate_s seconds later, then sets g_calibration_proceed to true.
+  noInterrupts();
+    g_calibration_proceed = false;
+    g_gate_seconds = gate_s;
+    gpsPPScounter = 0;
+    g_calibration_armed = true; // Let the PPS interrupt gate the counter
 
-    // Enable the GPS PPS interrupt, the TIMER1_OVF_vect interrupt handler will enable the Timer1 counter after receiving the first PPS pulse
-    // and will then disable everything after 11 pulses (10 seconds of measurement) and set g_calibration_proceed to true.
-    noInterrupts();
-      g_calibration_proceed = false;
-      gpsPPScounter = 0;
-      overflowCounter = 0;
-    
-#if defined (GPS_PPS_ON_D2_OR_D3)  
-      // Using External Interrupt on PIN D2 or D3 for GPS PPS 
-      EIMSK = (1 << INT0); // Enable GPS PPS external interupt (INT1 on PIN D3) - CHANGE THIS TO "INT0" if using PIN D2
-#else
-      // Using PinChange Interrupts on Pins other than D2 or D3 
-      PCIFR  = (1 << PCIF1);   // [Pin Change Interrupt Flag Register] clear any outstanding interrupts, counterintuitively writing a 1 clears the flag
-      PCMSK1 = (1<<PCINT13); // [Pin Change Mask Register 1] Enable Interrupts for PCINT13 on PIN A5 
-      is_PPS_rising_edge = false; // Reset our flag so we can mimic external interrupts triggering on rising edge
-#endif 
+    // Start counter, if it isn't already running
+    TCCR1B = TIMER1_COUNTER_TCCR1B;
+    TIMSK1 = TIMER1_COUNTER_TIMSK1;
+  interrupts();
 
-      // Start counter
-      TCCR1B = (1 << CS12) | (1 << CS11) | (1 << CS10);
-      TIMSK1 = (1 << TOIE1); // Enable Timer1 Overflow Interrupt
-    interrupts();
+  // Wait here until the proceed flag is set by the PPS interrupt at the end of the gate, or give up on the PPS.
+  // Software serial output would hold off the PPS interrupt, it waits for the end of the gate.
+  g_gate_timed_out = false;
+  serial_monitor_pause(true);
+  while (!g_calibration_proceed) {
+    if (millis() - start_ms > (gate_s + 1) * 1000UL + CALIBRATION_GATE_TIMEOUT_MS) {
+      serial_monitor_pause(false);
+      g_calibration_armed = false;
+      g_gate_timed_out = true;
+      return 0;
+    }
+    serial_monitor_poll();
+  }
+  serial_monitor_pause(false);
 
-    while (!g_calibration_proceed); // LOOP in place here until the proceed flag is set by PPSinterruptISR after 10 seconds of sampling
+  // Done sampling, the count is the difference between the two timestamps
+  noInterrupts();
+    count = g_gate_end_stamp - g_gate_start_stamp;
+  interrupts();
 
-    // Done the 10 seconds of sampling, take the count and calculate the frequency.
-    noInterrupts();
-      timer_counter1 = TCNT1;
-    interrupts();
+  return (count * 100ULL) / gate_s;
+}
 
-    // We multiply by ten as we are only sampling to a 10th of a Hz but target frequency is expressed in hundredths of Hz
-    measured_rx_freq = (timer_counter1 + (65536 * (int64_t)overflowCounter)) * 10ULL;
+// Load a new correction factor and restart the calibration clock with it
+static void apply_correction(int32_t correction) {
+  old_cal_factor = cal_factor;
+  cal_factor = correction;
+  si5351bx_set_correction(cal_factor);
+  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq);
+  delay(10);
+}
 
-    old_cal_factor = cal_factor;
+// Calibration is over, back to the PARK clock
+static void calibration_clocks_off() {
+  // Turn off the Calibration clock
+  si5351bx_enable_clk(SI5351A_CAL_CLK_NUM, SI5351_CLK_OFF);
 
-    // We apply the Huff&Puff method of frequency adjustement by adding or subtracting a fixed calibration step over and over
-    // We discard the first measurement (i=0) as it is always low.
-    if (i != 0 ) {
+  // Turn on the PARK clock
+  park_on();
+}
+
+static unsigned long g_calibration_total_ms = 0;   // Time spent calibrating since power up
+
+// The last CALIBRATION_RESULTS calibrations, oldest first from g_calibration_result_next once the ring is full
+static struct CalibrationResult g_calibration_results[CALIBRATION_RESULTS];
+static uint8_t g_calibration_result_next = 0;
+static uint16_t g_calibration_result_count = 0;
 
-      // If measured_rx_freq == target_freq we don't modify the cal_factor.
-      if (measured_rx_freq != 0 ) {
-        if (measured_rx_freq < target_freq)
-          cal_factor = cal_factor - calibration_step;
+static const char *g_calibration_status_names[] = {"PASS", "MODEL", "DISAGREE", "NO_PPS", "NO_CLOCK", "NO_CONVERGE"};
+
+// Start a new record, overwriting the oldest
+static struct CalibrationResult *calibration_result_new(int temperature_c) {
+  struct CalibrationResult *result = &g_calibration_results[g_calibration_result_next];
+
+  g_calibration_result_next = (g_calibration_result_next + 1) % CALIBRATION_RESULTS;
+  g_calibration_result_count++;
+
+  memset(result, 0, sizeof(*result));
+  result->time = now();
+  result->temperature_c = (int8_t)constrain(temperature_c, -128, 127);
+  return result;
+}
 
-        if (measured_rx_freq > target_freq)
-          cal_factor = cal_factor + calibration_step;
+static void calibration_result_round(struct CalibrationResult *result, uint8_t gate_s, int32_t error_chz) {
+  if (result->gates < CALIBRATION_RESULT_ROUNDS) {
+    result->rounds[result->gates].gate_s = gate_s;
+    result->rounds[result->gates].error_chz = error_chz;
+  }
+  result->gates++;
+}
+
+static int32_t chz_to_ppb(int32_t error_chz) {
+  return (int32_t)(((int64_t)error_chz * 1000000000LL) / (int64_t)target_freq);
+}
+
+// One gate of a calibration. Returns false if it failed, record->status says why.
+static bool calibration_gate(struct CalibrationResult *record, uint8_t gate_s, int32_t *error_chz) {
+  measured_rx_freq = measure_cal_freq(gate_s);
+
+  if (g_gate_timed_out) {
+    record->status = CAL_FAIL_NO_PPS; // Lost the PPS, don't wait any longer
+    return false;
+  }
+  if (measured_rx_freq == 0) {
+    // Measured Frequency is Zero so the calibration has failed
+    swerr(8, 0); // measured_rx_freq is zero so don't modify the calibration factor
+    record->status = CAL_FAIL_NO_CLOCK;
+    return false;
+  }
+
+  *error_chz = (int32_t)(measured_rx_freq - target_freq);
+  calibration_result_round(record, gate_s, *error_chz);
+  return true;
+}
+
+// Whether two more gates of gate_s, each with its wait for the first PPS edge, end within CALIBRATION_MAX_S
+static bool calibration_pair_fits(unsigned long start_ms, uint8_t gate_s) {
+  return (millis() - start_ms) + (2UL * gate_s + 2) * 1000UL <= CALIBRATION_MAX_S * 1000UL;
+}
+
+// Returns 0 if the calibration converged, 1 if it failed and the previous correction was put back
+uint8_t do_calibration(unsigned long calibration_step, int temperature_c) {
+  unsigned long start_ms = millis();
+  int32_t entry_correction = cal_factor;
+  struct CalibrationResult *record = calibration_result_new(temperature_c);
+  uint8_t result;
+  int32_t error_chz = 0;   // Measured minus target frequency, mean of the last pair of gates, in hundredths of Hz
+  int32_t second_chz;
+  int32_t noise_chz = 0;   // Spread of the last pair, at least one count over the gate
+  int64_t correction_ppb;
+  uint8_t gate_s = CALIBRATION_GATE_MIN_S;
+  uint8_t gates = 0;
+  uint16_t gate_total_s = 0;
+  char msg[80];
+
+  gemini_log("*** Starting Calibration ***");
+
+  // The first gate after the clock has been (re)started always reads low, a short one is enough to settle
+  measure_cal_freq(1);
+  record->status = g_gate_timed_out ? CAL_FAIL_NO_PPS : CAL_PASS;
+
+  // Pairs of gates, short while the error is large and doubling as it shrinks. The difference between the two
+  // gates of a pair is what the noise really is, a PPS interrupt held off by another one included, so the error
+  // is only trusted beyond it. Done when the worst case residual is below CALIBRATION_STOP_PPB, or failed when
+  // CALIBRATION_MAX_S is up first.
+  while (record->status == CAL_PASS) {
+    while ((gate_s > CALIBRATION_GATE_MIN_S) && !calibration_pair_fits(start_ms, gate_s)) gate_s /= 2;
+    if (!calibration_pair_fits(start_ms, gate_s)) {
+      swerr(9, error_chz); // Not converging
+      record->status = CAL_FAIL_NOT_CONVERGED;
+      break;
+    }
+
+    if (!calibration_gate(record, gate_s, &error_chz) || !calibration_gate(record, gate_s, &second_chz)) break;
+    gates += 2;
+    gate_total_s += 2 * gate_s;
+
+    noise_chz = max(abs(error_chz - second_chz), (int32_t)((100 + gate_s - 1) / gate_s));
+    error_chz = (error_chz + second_chz) / 2;
+
+    if (chz_to_ppb(abs(error_chz) + noise_chz) <= CALIBRATION_STOP_PPB) break; // Good enough
+
+    if (abs(error_chz) <= noise_chz) {
+      // Within the noise of this pair, the error can't be trusted beyond its sign
+      if (noise_chz > (100 + gate_s - 1) / gate_s) continue; // The gates disagree, one was held off, measure again
+      if ((gate_s < CALIBRATION_GATE_MAX_S) && calibration_pair_fits(start_ms, gate_s * 2)) {
+        gate_s *= 2;
+        continue;
       }
-      else {
-        // Measured Frequency is Zero so the calibration has failed
-        // Todo -  This should be handled by aborting and returning a Fail return code
-        swerr(8, 0); // measured_rx_freq is zero so don't modify the calibration factor
+      if (gate_s < CALIBRATION_GATE_MAX_S) {
+        swerr(9, error_chz); // Out of time before a gate long enough to resolve it
+        record->status = CAL_FAIL_NOT_CONVERGED;
+        break;
       }
+      // Even the longest gate can't resolve it, nudge by a fine step and let the next calibration average it out
+      if (error_chz < 0)
+        apply_correction(cal_factor - calibration_step);
+      else if (error_chz > 0)
+        apply_correction(cal_factor + calibration_step);
+      break;
+    }
 
-      si5351bx_set_correction(cal_factor); // Update the correction factor and reset the frequency to use it
-      si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq);
+    // The Si5351 code scales its reference by (1 + correction / 1e9) so the output moves by the inverse.
+    // Scaling the current reference by measured / target cancels the error we just measured.
+    correction_ppb = ((int64_t)error_chz * (1000000000LL + cal_factor)) / (int64_t)target_freq;
+    apply_correction(cal_factor + (int32_t)correction_ppb);
 
-      delay(10);
+    // What is left is down to the resolution of this gate, verify with a longer one
+    gate_s = min(gate_s * 2, CALIBRATION_GATE_MAX_S);
+  }
 
-    } // end if i!= 0
+  g_calibration_total_ms += millis() - start_ms;
 
+  result = (record->status == CAL_PASS) ? 0 : 1;
+
+  // The corrections applied by the rounds so far come from gates that didn't lead anywhere
+  if (result != 0) calibration_restore(entry_correction);
+  record->correction = cal_factor;
+  record->residual_ppb = chz_to_ppb(error_chz);
+  record->duration_s = (millis() - start_ms) / 1000;
+  gemini_log_calibration(record);
+
+  // Convergence time and residual error, in hundredths of Hz and in ppb
+  // Two lines, together they don't fit in msg with every value at its widest
+  sprintf(msg, "Cal %s corr:%ld res_chz:%ld res_ppb:%ld", g_calibration_status_names[record->status],
+          (long)cal_factor, (long)error_chz, (long)record->residual_ppb);
+  gemini_log(msg);
+  sprintf(msg, "Cal gates:%u gate_s:%u ms:%lu total_ms:%lu", gates, gate_total_s, millis() - start_ms,
+          g_calibration_total_ms);
+  gemini_log(msg);
+
+  calibration_clocks_off();
+  return result;
+} // end do_calibration
+
+// Calibrate at temperature_c. If the model has a correction for this temperature it is applied and checked with a
+// single gate, the full calibration only runs when there is no data or the check disagrees with the model.
+uint8_t do_model_calibration(unsigned long calibration_step, int temperature_c) {
+  unsigned long start_ms = millis();
+  struct CalibrationResult *record;
+  int32_t entry_correction = cal_factor;
+  int32_t correction, error_chz, error_ppb;
+  char msg[64];
+
+  if (cal_model_lookup(temperature_c, &correction)) {
+    record = calibration_result_new(temperature_c);
+    apply_correction(correction);
+    measure_cal_freq(1); // Settle
+    if (!g_gate_timed_out) measured_rx_freq = measure_cal_freq(CALIBRATION_GATE_S);
+    error_chz = (int32_t)(measured_rx_freq - target_freq);
+    error_ppb = chz_to_ppb(error_chz);
+
+    record->duration_s = (millis() - start_ms) / 1000;
+    if (g_gate_timed_out) {
+      calibration_restore(entry_correction);
+      record->correction = cal_factor;
+      record->status = CAL_FAIL_NO_PPS;
+      gemini_log_calibration(record);
+      calibration_clocks_off();
+      return 1; // A full calibration would only time out as well
+    }
+    record->correction = cal_factor;
+    calibration_result_round(record, CALIBRATION_GATE_S, error_chz);
+    record->residual_ppb = error_ppb;
+    record->status = ((measured_rx_freq != 0) && (abs(error_ppb) <= CAL_MODEL_TOLERANCE_PPB)) ? CAL_PASS_MODEL : CAL_MODEL_DISAGREE;
+    gemini_log_calibration(record);
+
+    sprintf(msg, "Cal model %dC corr:%ld chk_ppb:%ld", temperature_c, (long)correction, (long)error_ppb);
+    gemini_log(msg);
+
+    if (record->status == CAL_PASS_MODEL) {
+      calibration_clocks_off();
+      return 0;
+    }
+    apply_correction(entry_correction); // The model is off, calibrate from the correction we had before it
+  }
+
+  if (do_calibration(calibration_step, temperature_c) != 0) return 1;
+  cal_model_update(temperature_c, cal_factor);
+  return 0;
+}
+
+// Load the model correction for temperature_c, if there is one. Only the correction factor is changed,
+// it takes effect on the next si5351bx_setfreq() of each clock.
+void calibration_apply_model(int temperature_c) {
+  int32_t correction;
+
+  if (!is_selfcalibration_on() || !cal_model_lookup(temperature_c, &correction)) return;
+  if (correction == cal_factor) return;
+
+  old_cal_factor = cal_factor;
+  cal_factor = correction;
+  si5351bx_set_correction(cal_factor);
+}
+
+/*
+   Background calibration service (CALIBRATION_BACKGROUND)
+
+   Instead of blocking in do_calibration() the calibration clock is left running and Timer1 left counting it,
+   the PPS interrupt timestamps every edge and cal_service_poll() picks up the counts between edges from the
+   main loop. One second intervals are collected into gates of CALIBRATION_GATE_S and each gate is folded into
+   a running estimate. The scheduler only calls cal_service_apply() before each slot.
+   The service steps aside with cal_service_suspend() while Timer1 is the WSPR symbol timer.
+*/
+
+#define CAL_BG_SETTLE_INTERVALS  1     // The first interval after the clock has been (re)started reads low
+#define CAL_BG_MAX_INTERVAL_S    60    // Longest PPS interval we accept when the main loop was busy elsewhere
+#define CAL_BG_MAX_PPM           50    // Intervals further than this from nominal are missed or spurious PPS edges
+#define CAL_BG_OUTLIER_CHZ       (4 * CALIBRATION_NOISE_FLOOR)  // A gate further than this from the estimate disagrees
+#define CAL_BG_MAX_OUTLIERS      3     // After this many disagreeing gates in a row the frequency has moved, start over
+
+// Forget the estimate, the next PPS edge becomes the new reference
+static void cal_service_restart() {
+  g_cal_bg_have_stamp = false;
+  g_cal_bg_settle = CAL_BG_SETTLE_INTERVALS;
+  g_cal_bg_gate_residual = 0;
+  g_cal_bg_gate_seconds = 0;
+  g_cal_bg_residual = 0;
+  g_cal_bg_seconds = 0;
+  g_cal_bg_outliers = 0;
+}
+
+void cal_service_start() {
+  if (g_cal_service_running) return;
+
+  timer1_counter_begin();
+  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq); // The PARK clock stays on, it keeps the Si5351 warm
+  cal_service_restart();
+  g_cal_service_running = true;
+  gemini_log("*** Background calibration started ***");
+}
+
+void cal_service_suspend() {
+  if (!g_cal_service_running) return;
 
-  } // end for
-  
-  // Turn off the Calibration clock
   si5351bx_enable_clk(SI5351A_CAL_CLK_NUM, SI5351_CLK_OFF);
+  g_cal_bg_have_stamp = false; // Timer1 is about to be reconfigured, the count won't be continuous
+}
 
-  // Turn on the PARK clock
-  si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL)); // Turn on Park Clock
+void cal_service_resume() {
+  if (!g_cal_service_running) return;
 
+  timer1_counter_begin();
+  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq);
+  g_cal_bg_have_stamp = false;
+  g_cal_bg_settle = CAL_BG_SETTLE_INTERVALS;
+}
 
-} // end do_calibration
+// A gate has been completed, fold it into the running estimate
+static void cal_service_gate_done() {
+  int32_t gate_chz, estimate_chz;
+
+  if (g_cal_bg_seconds > 0) {
+    gate_chz = (g_cal_bg_gate_residual * 100L) / (int32_t)g_cal_bg_gate_seconds;
+    estimate_chz = (g_cal_bg_residual * 100L) / (int32_t)g_cal_bg_seconds;
+    if (abs(gate_chz - estimate_chz) > CAL_BG_OUTLIER_CHZ) {
+      if (++g_cal_bg_outliers >= CAL_BG_MAX_OUTLIERS) {
+        // The frequency has moved (i.e. a temperature step), restart the estimate from this gate
+        g_cal_bg_residual = 0;
+        g_cal_bg_seconds = 0;
+        g_cal_bg_outliers = 0;
+      }
+    }
+    else
+      g_cal_bg_outliers = 0;
+  }
+
+  g_cal_bg_residual += g_cal_bg_gate_residual;
+  g_cal_bg_seconds += g_cal_bg_gate_seconds;
+  g_cal_bg_gate_residual = 0;
+  g_cal_bg_gate_seconds = 0;
+
+  // Keep a sliding window, scaling preserves the mean of what we have
+  if (g_cal_bg_seconds > CAL_BG_WINDOW_S) {
+    g_cal_bg_residual = (g_cal_bg_residual * (int32_t)(CAL_BG_WINDOW_S / 2)) / (int32_t)g_cal_bg_seconds;
+    g_cal_bg_seconds = CAL_BG_WINDOW_S / 2;
+  }
+}
+
+void cal_service_poll() {
+  unsigned long edges, stamp, seconds, count, nominal;
+
+  if (!g_cal_service_running) return;
+
+  noInterrupts();
+    edges = g_pps_edge_count;
+    stamp = g_pps_last_stamp;
+  interrupts();
+
+  if (edges == g_cal_bg_last_edges) return; // No new PPS edge
+
+  seconds = edges - g_cal_bg_last_edges;
+  if (g_cal_bg_have_stamp && (seconds <= CAL_BG_MAX_INTERVAL_S)) {
+    count = stamp - g_cal_bg_last_stamp;
+    nominal = (unsigned long)(target_freq / 100) * seconds;
+
+    if (g_cal_bg_settle > 0)
+      g_cal_bg_settle--;
+    else if (labs((long)(count - nominal)) <= (long)(nominal / (1000000UL / CAL_BG_MAX_PPM))) {
+      g_cal_bg_gate_residual += (long)(count - nominal);
+      g_cal_bg_gate_seconds += seconds;
+      if (g_cal_bg_gate_seconds >= CALIBRATION_GATE_S) cal_service_gate_done();
+    }
+    // Otherwise a PPS edge has been missed or was spurious, drop the interval
+  }
+
+  g_cal_bg_last_edges = edges;
+  g_cal_bg_last_stamp = stamp;
+  g_cal_bg_have_stamp = true;
+}
+
+void cal_service_estimate(struct CalEstimate *estimate) {
+  int16_t confidence = 0;
+
+  estimate->seconds = g_cal_bg_seconds;
+  estimate->error_chz = 0;
+  if (g_cal_bg_seconds > 0) {
+    estimate->error_chz = (g_cal_bg_residual * 100L) / (int32_t)g_cal_bg_seconds;
+    confidence = ((uint32_t)g_cal_bg_seconds * 100UL) / CAL_BG_CONFIDENT_S;
+    if (confidence > 100) confidence = 100;
+    confidence -= 25 * g_cal_bg_outliers; // Recent gates don't agree
+    if (confidence < 0) confidence = 0;
+  }
+  estimate->confidence = confidence;
+}
+
+void cal_service_apply(int temperature_c) {
+  struct CalibrationResult *record;
+  struct CalEstimate estimate;
+  int64_t correction_ppb;
+  int32_t correction;
+  char msg[64];
+
+  if (!g_cal_service_running || !is_selfcalibration_on()) return;
+
+  cal_service_estimate(&estimate);
+  if (estimate.confidence < CAL_BG_MIN_CONFIDENCE) {
+    // Not enough counting yet, go by the model. The estimate so far was made with the old correction.
+    if (cal_model_lookup(temperature_c, &correction) && (correction != cal_factor)) {
+      apply_correction(correction);
+      cal_service_restart();
+    }
+    return;
+  }
+
+  // +/- one count over the whole estimate is all we can resolve, below that keep on averaging
+  if (abs(estimate.error_chz) <= (int32_t)(100 / estimate.seconds)) {
+    cal_model_update(temperature_c, cal_factor); // The current correction is as good as we can measure
+    return;
+  }
+
+  // Same direct correction as do_calibration()
+  correction_ppb = ((int64_t)estimate.error_chz * (1000000000LL + cal_factor)) / (int64_t)target_freq;
+  apply_correction(cal_factor + (int32_t)correction_ppb);
+  measured_rx_freq = target_freq + estimate.error_chz;
+
+  sprintf(msg, "Cal bg corr:%ld err_chz:%ld s:%u conf:%u", (long)cal_factor, (long)estimate.error_chz,
+          estimate.seconds, estimate.confidence);
+  gemini_log(msg);
+
+  record = calibration_result_new(temperature_c);
+  record->status = CAL_PASS;
+  record->correction = cal_factor;
+  record->duration_s = estimate.seconds;
+  calibration_result_round(record, (uint8_t)min(estimate.seconds, 255), estimate.error_chz);
+  gemini_log_calibration(record);
+
+  cal_model_update(temperature_c, cal_factor);
+  cal_service_restart(); // The counts so far were taken with the old correction
+}
+
+// Asked for from the monitor, the service is always counting so a calibration is applying what it has now.
+// The outcome is the reply, printed whether the info log is on or not.
+void cal_service_request(int temperature_c) {
+  struct CalEstimate estimate;
+  int32_t entry_correction = cal_factor;
+  char msg[64];
+
+  if (!g_cal_service_running || !is_selfcalibration_on()) {
+    gemini_print("Cal bg not running, nothing applied");
+    return;
+  }
+
+  cal_service_estimate(&estimate);
+  cal_service_apply(temperature_c);
+
+  // The correction is unchanged when the estimate is within one count, or not confident yet and no model
+  sprintf(msg, "Cal bg request corr:%ld->%ld s:%u conf:%u", (long)entry_correction, (long)cal_factor,
+          estimate.seconds, estimate.confidence);
+  gemini_print(msg);
+}
+
+/*
+   Processor clock error
+
+   micros() between PPS edges over MCU_CLOCK_GATE_S seconds, 8 us resolution at 8 MHz so about 0.1 ppm.
+   Positive means the processor clock runs fast.
+*/
+
+#define MCU_CLOCK_GATE_S  64
+
+static bool g_mcu_clock_have_ref = false;
+static bool g_mcu_clock_measured = false;
+static unsigned long g_mcu_clock_ref_edges = 0;
+static unsigned long g_mcu_clock_ref_us = 0;
+static int32_t g_mcu_clock_error_ppb = 0;
+
+void mcu_clock_poll() {
+  unsigned long edges, us, seconds;
+  long error_us;
+  int32_t error_ppb;
+
+  noInterrupts();
+    edges = g_pps_edge_count;
+    us = g_pps_last_us;
+  interrupts();
+
+  if (g_mcu_clock_have_ref) {
+    seconds = edges - g_mcu_clock_ref_edges;
+    if (seconds < MCU_CLOCK_GATE_S) return;
+
+    // A missed PPS edge shows up as a 1/seconds error, far beyond any clock error
+    error_us = (long)(us - g_mcu_clock_ref_us - seconds * 1000000UL);
+    if ((seconds <= 3600) && (labs(error_us) < (long)(seconds * 10000UL))) { // micros() wraps after 71 minutes
+      error_ppb = (int32_t)(((int64_t)error_us * 1000LL) / (long)seconds);
+      if (g_mcu_clock_measured)
+        g_mcu_clock_error_ppb += (error_ppb - g_mcu_clock_error_ppb) / 4;
+      else
+        g_mcu_clock_error_ppb = error_ppb;
+      g_mcu_clock_measured = true;
+    }
+  }
+
+  g_mcu_clock_ref_edges = edges;
+  g_mcu_clock_ref_us = us;
+  g_mcu_clock_have_ref = true;
+}
+
+int32_t mcu_clock_error_ppb() {
+  return g_mcu_clock_error_ppb;
+}
+
+// Start from a previously measured error, the next measurement is averaged into it
+void mcu_clock_restore(int32_t error_ppb) {
+  g_mcu_clock_error_ppb = error_ppb;
+  g_mcu_clock_measured = true;
+}
+
+int32_t calibration_correction() {
+  return cal_factor;
+}
+
+// Start from a previously calibrated correction instead of SI5351A_CLK_FREQ_CORRECTION
+void calibration_restore(int32_t correction) {
+  old_cal_factor = cal_factor = correction;
+  si5351bx_set_correction(cal_factor);
+}
+
+/*
+   In-transmission frequency monitoring (TX_FREQ_MONITOR)
+
+   Timer1 is normally the WSPR symbol timer during a transmission, so nothing can be counted. In this mode
+   Timer1 keeps counting the calibration clock and the symbols are timed from that count instead, with the
+   compare match interrupt: a symbol is 8192/12000 s, 2184533 1/3 counts at 3.2 MHz,
+   with the fraction carried from one symbol to the next. The PPS edges keep
+   being timestamped, so the Si5351 reference is measured all through the transmission while the chip heats up.
+   The CAL and TX clocks share the crystal and PLL, every TX_MONITOR_GATE_S the correction is updated
+   and it is picked up by the next symbol's si5351bx_setfreq(). The CAL clock itself is left alone during the
+   transmission so each gate is measured against the same multisynth setting.
+*/
+
+static volatile unsigned long g_tx_symbol_target = 0;   // Timer1 count at the end of the current symbol
+static volatile uint16_t g_tx_symbol_frac = 0;          // Fraction of a count carried over, in 1/12000
+static uint32_t g_tx_symbol_q = 0;                      // Counts per symbol, integer part
+static uint16_t g_tx_symbol_r = 0;                      // and fraction in 1/12000
+static int32_t g_tx_cal_correction = 0;                 // Correction the CAL clock was set with
+static int32_t g_tx_correction = 0;                     // Correction applied to the TX clock
+static unsigned long g_tx_last_edges = 0;
+static unsigned long g_tx_last_stamp = 0;
+static bool g_tx_have_stamp = false;
+static int32_t g_tx_gate_residual = 0;
+static uint16_t g_tx_gate_seconds = 0;
+static uint16_t g_tx_elapsed_s = 0;
+static uint8_t g_tx_drift_count = 0;
+static int32_t g_tx_drift_ppb[TX_MONITOR_MAX_POINTS];   // Reference error measured by each gate, up to CAL_BG_MAX_PPM
+static uint16_t g_tx_drift_s[TX_MONITOR_MAX_POINTS];    // and when, seconds into the transmission
+
+// Called from the Timer1 compare match interrupt, every 65536 counts. Returns true at the end of a symbol.
+bool tx_monitor_symbol_due() {
+  unsigned long target;
+
+  if ((long)(timer1_stamp(OCR1A) - g_tx_symbol_target) < 0) return false;
+
+  target = g_tx_symbol_target + g_tx_symbol_q;
+  g_tx_symbol_frac += g_tx_symbol_r;
+  if (g_tx_symbol_frac >= 12000) {
+    g_tx_symbol_frac -= 12000;
+    target++;
+  }
+  g_tx_symbol_target = target;
+  OCR1A = (uint16_t)target;
+  return true;
+}
+
+// Before the transmission, in place of the CTC symbol timer setup
+void tx_monitor_begin() {
+  g_tx_cal_correction = g_tx_correction = cal_factor;
+  g_tx_have_stamp = false;
+  g_tx_gate_residual = 0;
+  g_tx_gate_seconds = 0;
+  g_tx_elapsed_s = 0;
+  g_tx_drift_count = 0;
+  g_tx_symbol_q = (uint32_t)(((target_freq / 100) * 8192ULL) / 12000ULL);
+  g_tx_symbol_r = (uint16_t)(((target_freq / 100) * 8192ULL) % 12000ULL);
+
+  si5351bx_setfreq(SI5351A_CAL_CLK_NUM, target_freq);
+
+  noInterrupts();
+    TCCR1A = 0;
+    TCCR1B = TIMER1_COUNTER_TCCR1B;
+    TIFR1 = (1 << ICF1) | (1 << TOV1) | (1 << OCF1A);
+    TIMSK1 = TIMER1_COUNTER_TIMSK1; // The compare match is enabled by tx_monitor_sync()
+  interrupts();
+}
+
+// Start timing the first symbol from now
+void tx_monitor_sync() {
+  uint16_t count;
+
+  noInterrupts();
+    count = TCNT1;
+    g_tx_symbol_target = timer1_stamp(count) + g_tx_symbol_q;
+    g_tx_symbol_frac = g_tx_symbol_r;
+    OCR1A = (uint16_t)g_tx_symbol_target;
+    TIFR1 = (1 << OCF1A);
+    TIMSK1 = TIMER1_COUNTER_TIMSK1 | (1 << OCIE1A);
+  interrupts();
+}
+
+// Between symbols, picks up the counts between PPS edges and updates the correction at the end of each gate
+void tx_monitor_poll(unsigned long tx_freq_hz) {
+  unsigned long edges, stamp, seconds, count, nominal;
+  int32_t error_chz, correction, step;
+
+  noInterrupts();
+    edges = g_pps_edge_count;
+    stamp = g_pps_last_stamp;
+  interrupts();
+
+  if (edges == g_tx_last_edges) return;
+
+  seconds = edges - g_tx_last_edges;
+  if (g_tx_have_stamp) {
+    g_tx_elapsed_s += seconds;
+    count = stamp - g_tx_last_stamp;
+    nominal = (unsigned long)(target_freq / 100) * seconds;
+    if (labs((long)(count - nominal)) <= (long)(nominal / (1000000UL / CAL_BG_MAX_PPM))) {
+      g_tx_gate_residual += (long)(count - nominal);
+      g_tx_gate_seconds += seconds;
+    }
+  }
+  g_tx_last_edges = edges;
+  g_tx_last_stamp = stamp;
+  g_tx_have_stamp = true;
+
+  if (g_tx_gate_seconds < TX_MONITOR_GATE_S) return;
+
+  // Error of the reference against the CAL clock setting, which was made with g_tx_cal_correction
+  error_chz = (g_tx_gate_residual * 100L) / (int32_t)g_tx_gate_seconds;
+  g_tx_gate_residual = 0;
+  g_tx_gate_seconds = 0;
+
+  if (g_tx_drift_count < TX_MONITOR_MAX_POINTS) {
+    g_tx_drift_s[g_tx_drift_count] = g_tx_elapsed_s;
+    g_tx_drift_ppb[g_tx_drift_count] = (int32_t)(((int64_t)error_chz * 1000000000LL) / (int64_t)target_freq);
+    g_tx_drift_count++;
+  }
+
+  if (!is_selfcalibration_on()) return;
+
+  // Small steps only, a jump in the middle of a transmission is worse than a little drift
+  correction = g_tx_cal_correction + (int32_t)(((int64_t)error_chz * (1000000000LL + g_tx_cal_correction)) / (int64_t)target_freq);
+  step = correction - g_tx_correction;
+  step = constrain(step, -TX_MONITOR_MAX_STEP_PPB, TX_MONITOR_MAX_STEP_PPB);
+
+  // Below the resolution of a gate it isn't worth touching, about 0.1 Hz at the TX frequency
+  if ((((int64_t)abs(step) * tx_freq_hz) / 10000000LL) < 10) return;
+
+  g_tx_correction += step;
+  si5351bx_set_correction(g_tx_correction);
+}
+
+// After the transmission, back to the correction calibrated with the PARK clock running and log the drift profile
+void tx_monitor_end(unsigned long tx_freq_hz) {
+  char msg[120];   // 6 points of up to 18 characters
+  uint8_t i, n;
+  int n_chars;
+
+  noInterrupts();
+    TIMSK1 = TIMER1_COUNTER_TIMSK1;
+  interrupts();
+  si5351bx_enable_clk(SI5351A_CAL_CLK_NUM, SI5351_CLK_OFF);
+  si5351bx_set_correction(cal_factor);
+
+  sprintf(msg, "TX mon corr:%ld end:%ld pts:%u", (long)g_tx_cal_correction, (long)g_tx_correction, g_tx_drift_count);
+  gemini_log(msg);
+
+  // seconds:drift at the TX frequency in hundredths of Hz, relative to the start of the transmission
+  for (i = 0; i < g_tx_drift_count; i += n) {
+    n_chars = sprintf(msg, "TX drift");
+    for (n = 0; (n < 6) && (i + n < g_tx_drift_count); n++)
+      n_chars += sprintf(msg + n_chars, " %u:%ld", g_tx_drift_s[i + n],
+                         (long)((((int64_t)g_tx_drift_ppb[i + n] - g_tx_drift_ppb[0]) * (int64_t)tx_freq_hz) / 10000000LL));
+    gemini_log(msg);
+  }
+}
+
+/*
+   Calibration results
+*/
+
+// Dump the calibration records through the serial monitor, oldest first
+void calibration_results_dump() {
+  struct CalibrationResult *result;
+  char msg[80];
+  uint8_t i, n, r, first;
+  int n_chars;
+
+  n = (g_calibration_result_count < CALIBRATION_RESULTS) ? g_calibration_result_count : CALIBRATION_RESULTS;
+  first = (g_calibration_result_count < CALIBRATION_RESULTS) ? 0 : g_calibration_result_next;
+
+  sprintf(msg, "Cal results:%u total_ms:%lu", g_calibration_result_count, g_calibration_total_ms);
+  gemini_log(msg);
+
+  for (i = 0; i < n; i++) {
+    result = &g_calibration_results[(first + i) % CALIBRATION_RESULTS];
+    // Two lines, together they don't fit in msg with every value at its widest
+    sprintf(msg, "Cal t:%lu %s %dC gates:%u s:%u", (unsigned long)result->time,
+            g_calibration_status_names[result->status], result->temperature_c, result->gates, result->duration_s);
+    gemini_log(msg);
+    sprintf(msg, " corr:%ld res_ppb:%ld", (long)result->correction, (long)result->residual_ppb);
+    gemini_log(msg);
+
+    // Each round as gate seconds, measured frequency in Hz and error in ppb
+    for (r = 0; r < min(result->gates, CALIBRATION_RESULT_ROUNDS); r++) {
+      n_chars = sprintf(msg, " %us %lu.%02luHz %ldppb", result->rounds[r].gate_s,
+                        (unsigned long)((target_freq + result->rounds[r].error_chz) / 100),
+                        (unsigned long)((target_freq + result->rounds[r].error_chz) % 100),
+                        (long)chz_to_ppb(result->rounds[r].error_chz));
+      if (n_chars > 0) gemini_log(msg);
+    }
+  }
+}
@@ -20,11 +20,91 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "GeminiXConfig.h"
+#include "GeminiBoardConfig.h"
 
 #define FINE_CORRECTION_STEP   10     // 0.1 HZ step
 #define COARSE_CORRECTION_STEP 100    // 10 Hz step
 
+// Counting gate of the background service and of the model check in seconds, one count is 1/10 Hz at the
+// 3.2 MHz calibration frequency with a 10 s gate.
+// With input capture there is no interrupt jitter at the gate edges so a shorter gate gives the same +/- 1 count.
+#if defined (GPS_PPS_ON_ICP1)
+#define CALIBRATION_GATE_S       4
+#else
+#define CALIBRATION_GATE_S       10
+#endif
+#define CALIBRATION_NOISE_FLOOR  (100 / CALIBRATION_GATE_S)   // +/- one count over the gate in hundredths of Hz
+
+// Gates of the blocking calibration start short and double as the error shrinks. One count is 1/gate_s Hz.
+#if defined (GPS_PPS_ON_ICP1)
+#define CALIBRATION_GATE_MIN_S   1
+#else
+#define CALIBRATION_GATE_MIN_S   2    // Interrupt latency jitter is a larger part of a short gate
+#endif
+#define CALIBRATION_GATE_MAX_S   64
+#define CALIBRATION_MAX_S        100  // Give up on converging after this long, less than a WSPR slot
+
+// Stop threshold in ppb from the residual at the TX frequency in CALIBRATION_STOP_RESIDUAL_CHZ
+#define CALIBRATION_STOP_PPB     ((int32_t)((CALIBRATION_STOP_RESIDUAL_CHZ * 10000000ULL) / BEACON_FREQ_HZ))
+
+#define CALIBRATION_GATE_TIMEOUT_MS  2000  // A gate gives up when the PPS is this late
+#define CALIBRATION_RESULTS        4      // Calibration records kept
+#define CALIBRATION_RESULT_ROUNDS  6      // Gates kept per record
+
+enum CalibrationStatus {CAL_PASS, CAL_PASS_MODEL, CAL_MODEL_DISAGREE, CAL_FAIL_NO_PPS, CAL_FAIL_NO_CLOCK, CAL_FAIL_NOT_CONVERGED};
+
+struct CalibrationRound {
+  uint8_t gate_s;
+  int32_t error_chz;       // Measured minus target frequency, hundredths of Hz
+};
+
+struct CalibrationResult {
+  uint32_t time;           // When it ran, TimeLib time
+  int32_t correction;      // Final correction in ppb
+  int32_t residual_ppb;    // Error measured by the last gate
+  uint16_t duration_s;
+  uint8_t gates;           // Gates measured, only the first CALIBRATION_RESULT_ROUNDS are kept
+  uint8_t status;          // enum CalibrationStatus
+  int8_t temperature_c;
+  struct CalibrationRound rounds[CALIBRATION_RESULT_ROUNDS];
+};
+
+// Running estimate published by the background calibration service
+struct CalEstimate {
+  int32_t error_chz;     // Calibration clock minus target frequency, in hundredths of Hz
+  uint16_t seconds;      // PPS seconds of counting behind the estimate
+  uint8_t confidence;    // 0 to 100 %
+};
+
+void pps_begin();
+unsigned long pps_edge_count();
 void setup_calibration();
 void reset_for_calibration();
-void do_calibration(unsigned long calibration_step);
+uint8_t do_calibration(unsigned long calibration_step, int temperature_c);
+uint8_t do_model_calibration(unsigned long calibration_step, int temperature_c);
+void calibration_results_dump();                   // Through the serial monitor, oldest first
+void calibration_apply_model(int temperature_c);   // Before a slot, load the model correction for the temperature
+
+int32_t calibration_correction();
+void calibration_restore(int32_t correction);
+
+void mcu_clock_poll();         // Call from the main loop, measures the processor clock against the PPS
+int32_t mcu_clock_error_ppb();
+void mcu_clock_restore(int32_t error_ppb);
+
+void cal_service_start();      // Start counting in the background, the calibration clock stays on
+void cal_service_suspend();    // Timer1 is needed as the symbol timer
+void cal_service_resume();
+void cal_service_poll();       // Call from the main loop, picks up the counts between PPS edges
+void cal_service_estimate(struct CalEstimate *estimate);
+void cal_service_apply(int temperature_c);   // Apply the latest correction, or the model's if the estimate isn't good enough yet
+void cal_service_request(int temperature_c); // cal_service_apply() now and print the outcome, for the monitor
+
+#define TX_MONITOR_MAX_POINTS    16   // Drift profile points logged per transmission, one per gate
+
+bool tx_monitor_symbol_due();  // From the Timer1 compare match ISR
+void tx_monitor_begin();       // In place of the CTC symbol timer setup
+void tx_monitor_sync();        // Start of the first symbol
+void tx_monitor_poll(unsigned long tx_freq_hz);   // Between symbols
+void tx_monitor_end(unsigned long tx_freq_hz);
 #endif
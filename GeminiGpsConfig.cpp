@@ -0,0 +1,226 @@
+/*
+   GeminiGpsConfig.cpp - GPS receiver startup configuration.
+
+   By default the GPS emits every NMEA sentence it knows about once per fix, while NeoGPS only
+   parses GPRMC and GPGGA. Every other sentence still costs receive interrupts and parser cycles
+   before it is thrown away, so at startup we tell the receiver to send only what we use.
+   The receiver family is selected in GeminiBoardConfig.h (GPS_RECEIVER_MTK or GPS_RECEIVER_UBLOX).
+
+   The result is confirmed by sampling the incoming traffic. If the sentences we need are missing
+   or the pruned ones are still there, the receiver defaults are restored so we never end up
+   with a GPS that is silent.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiXConfig.h"
+#include "GeminiBoardConfig.h"
+#include "GeminiGpsConfig.h"
+#include "GeminiSerialMonitor.h"
+
+#define GPS_STR(x)  #x
+#define GPS_XSTR(x) GPS_STR(x)
+
+static bool g_gps_config_ack = false;   // Set when the receiver acknowledges one of our commands
+
+// Map an NMEA address field (i.e. "GPRMC", "GNGGA") to its GPS_SENTENCE_xxx bit.
+// The talker ID varies between receivers (GP, GN, GL...) so only the sentence formatter is compared.
+static uint8_t classify_sentence(const char *tag) {
+
+  if ((tag[0] != 'G') || (strlen(tag) != 5)) return GPS_SENTENCE_OTHER;
+
+  tag += 2;
+  if (strcmp(tag, "RMC") == 0) return GPS_SENTENCE_RMC;
+  if (strcmp(tag, "GGA") == 0) return GPS_SENTENCE_GGA;
+  if (strcmp(tag, "GSA") == 0) return GPS_SENTENCE_GSA;
+  if (strcmp(tag, "GSV") == 0) return GPS_SENTENCE_GSV;
+  if (strcmp(tag, "GLL") == 0) return GPS_SENTENCE_GLL;
+  if (strcmp(tag, "VTG") == 0) return GPS_SENTENCE_VTG;
+  if (strcmp(tag, "ZDA") == 0) return GPS_SENTENCE_ZDA;
+  return GPS_SENTENCE_OTHER;
+}
+
+unsigned int gps_config_sample_traffic(Stream &port, unsigned int sample_ms, uint8_t *seen_mask) {
+  static const uint8_t ubx_ack_ack[4] = {0xB5, 0x62, 0x05, 0x01}; // UBX sync chars + ACK-ACK class/id
+  unsigned long start = millis();
+  unsigned long chars = 0;
+  char tag[8];
+  uint8_t tag_len = 0;
+  uint8_t ubx_match = 0;
+  uint8_t mtk_ack_field = 0;  // Field index while inside a $PMTK001 sentence, 0 otherwise
+  bool in_tag = false;
+  uint8_t c;
+
+  *seen_mask = 0;
+
+  while (millis() - start < sample_ms) {
+    if (!port.available()) continue;
+
+    c = port.read();
+    chars++;
+
+    // u-blox acknowledges a CFG message with a binary ACK-ACK
+    if (c == ubx_ack_ack[ubx_match]) {
+      if (++ubx_match == sizeof(ubx_ack_ack)) {
+        g_gps_config_ack = true;
+        ubx_match = 0;
+      }
+    }
+    else
+      ubx_match = (c == ubx_ack_ack[0]) ? 1 : 0;
+
+    if (c == '$') {
+      in_tag = true;
+      tag_len = 0;
+      mtk_ack_field = 0;
+    }
+    else if (in_tag) {
+      if ((c == ',') || (c == '*') || (tag_len == sizeof(tag) - 1)) {
+        tag[tag_len] = '\0';
+        in_tag = false;
+
+        if (strcmp(tag, "PMTK001") == 0)
+          mtk_ack_field = 1; // $PMTK001,<cmd>,<flag> - a flag of 3 means the command succeeded
+        else
+          *seen_mask |= classify_sentence(tag);
+      }
+      else
+        tag[tag_len++] = c;
+    }
+    else if (mtk_ack_field != 0) {
+      if (c == ',')
+        mtk_ack_field++;
+      else if (c == '*')
+        mtk_ack_field = 0;
+      else if ((mtk_ack_field == 2) && (c == '3'))
+        g_gps_config_ack = true;
+    }
+  }
+
+  return (unsigned int)((chars * 1000UL) / sample_ms);
+}
+
+void gps_send_nmea_P(Stream &port, const __FlashStringHelper *body) {
+  const char *p = (const char *)body;
+  uint8_t checksum = 0;
+  char c;
+
+  port.print('$');
+  while ((c = pgm_read_byte(p++)) != '\0') {
+    checksum ^= c;
+    port.print(c);
+  }
+  port.print('*');
+  if (checksum < 0x10) port.print('0');
+  port.print(checksum, HEX);
+  port.print(F("\r\n"));
+}
+
+#if defined (GPS_RECEIVER_UBLOX)
+// NMEA message IDs (class 0xF0) that we switch off on u-blox receivers
+static const uint8_t ubx_pruned_msgs[] = {0x01, 0x02, 0x03, 0x05}; // GLL, GSA, GSV, VTG
+#endif
+
+// Send a UBX frame. The Fletcher checksum covers class, id, length and payload.
+void gps_send_ubx(Stream &port, uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint8_t len) {
+  uint8_t hdr[4] = {msg_class, msg_id, len, 0};
+  uint8_t ck_a = 0, ck_b = 0;
+  uint8_t i;
+
+  port.write(0xB5);
+  port.write(0x62);
+  for (i = 0; i < sizeof(hdr); i++) {
+    port.write(hdr[i]);
+    ck_a += hdr[i];
+    ck_b += ck_a;
+  }
+  for (i = 0; i < len; i++) {
+    port.write(payload[i]);
+    ck_a += payload[i];
+    ck_b += ck_a;
+  }
+  port.write(ck_a);
+  port.write(ck_b);
+}
+
+#if defined (GPS_RECEIVER_UBLOX)
+// CFG-MSG (0x06 0x01) sets the output rate of one message on the current port
+static void gps_ubx_set_msg_rate(Stream &port, uint8_t nmea_id, uint8_t rate) {
+  uint8_t payload[3] = {0xF0, nmea_id, rate};
+  gps_send_ubx(port, 0x06, 0x01, payload, sizeof(payload));
+  delay(100);
+}
+#endif
+
+void gps_config_send(Stream &port) {
+#if defined (GPS_RECEIVER_MTK)
+  // PMTK314 field order: GLL, RMC, VTG, GGA, GSA, GSV, 11 reserved fields, ZDA, MCHN - keep RMC and GGA, once per fix
+  gps_send_nmea_P(port, F("PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0"));
+  delay(100);
+  gps_send_nmea_P(port, F("PMTK220," GPS_XSTR(GPS_FIX_INTERVAL_MS)));
+  delay(100);
+#elif defined (GPS_RECEIVER_UBLOX)
+  uint8_t i;
+  // CFG-RATE (0x06 0x08): measurement rate in ms, one measurement per navigation solution, aligned to GPS time
+  uint8_t rate[6] = {(uint8_t)(GPS_FIX_INTERVAL_MS & 0xFF), (uint8_t)(GPS_FIX_INTERVAL_MS >> 8), 1, 0, 1, 0};
+
+  for (i = 0; i < sizeof(ubx_pruned_msgs); i++)
+    gps_ubx_set_msg_rate(port, ubx_pruned_msgs[i], 0);
+
+  gps_send_ubx(port, 0x06, 0x08, rate, sizeof(rate));
+  delay(100);
+#endif
+}
+
+static void gps_config_restore(Stream &port) {
+#if defined (GPS_RECEIVER_MTK)
+  gps_send_nmea_P(port, F("PMTK314,-1")); // Restore the default NMEA output
+  delay(100);
+#elif defined (GPS_RECEIVER_UBLOX)
+  uint8_t i;
+
+  for (i = 0; i < sizeof(ubx_pruned_msgs); i++)
+    gps_ubx_set_msg_rate(port, ubx_pruned_msgs[i], 1);
+#endif
+}
+
+void gps_config_begin(Stream &port) {
+  char msg[72];
+  uint8_t seen_before, seen_after;
+  unsigned int cps_before, cps_after;
+
+  // Baseline with the receiver defaults
+  cps_before = gps_config_sample_traffic(port, GPS_CONFIG_SAMPLE_MS, &seen_before);
+
+  g_gps_config_ack = false;
+  gps_config_send(port);
+
+  // The receiver may still be sending the epoch that was in progress when the commands arrived,
+  // so listen for one fix interval (picking up any acknowledgement) before judging the traffic.
+  gps_config_sample_traffic(port, GPS_FIX_INTERVAL_MS + 200, &seen_after);
+  cps_after = gps_config_sample_traffic(port, GPS_CONFIG_SAMPLE_MS, &seen_after);
+
+  if (((seen_after & GPS_SENTENCES_USED) == GPS_SENTENCES_USED) && ((seen_after & GPS_SENTENCES_PRUNED) == 0)) {
+    sprintf(msg, "GPS config OK ack:%d chars/s %u -> %u", g_gps_config_ack, cps_before, cps_after);
+  }
+  else {
+    // Either the commands were ignored or the receiver stopped sending what we need, go back to defaults
+    gps_config_restore(port);
+    sprintf(msg, "GPS config not confirmed ack:%d seen:%02X/%02X, defaults restored", g_gps_config_ack, seen_before, seen_after);
+  }
+  gemini_log(msg);
+}
@@ -0,0 +1,57 @@
+#ifndef GEMINIGPSCONFIG_H
+#define GEMINIGPSCONFIG_H
+/*
+   GeminiGpsConfig.h - Definitions for the GPS receiver startup configuration
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+#define GPS_FIX_INTERVAL_MS     1000     // Fix rate requested from the receiver (1 Hz)
+#define GPS_CONFIG_SAMPLE_MS    3000     // How long we listen to the GPS traffic before and after configuring it
+
+// Bitmask of the NMEA sentence types seen while sampling the GPS traffic
+#define GPS_SENTENCE_RMC   0x01
+#define GPS_SENTENCE_GGA   0x02
+#define GPS_SENTENCE_GSA   0x04
+#define GPS_SENTENCE_GSV   0x08
+#define GPS_SENTENCE_GLL   0x10
+#define GPS_SENTENCE_VTG   0x20
+#define GPS_SENTENCE_ZDA   0x40
+#define GPS_SENTENCE_OTHER 0x80
+
+#define GPS_SENTENCES_USED   (GPS_SENTENCE_RMC | GPS_SENTENCE_GGA)  // What NeoGPS is configured to parse
+#define GPS_SENTENCES_PRUNED (GPS_SENTENCE_GSA | GPS_SENTENCE_GSV | GPS_SENTENCE_GLL | GPS_SENTENCE_VTG)
+
+// Disable every NMEA sentence the firmware does not use and set the fix rate, then confirm the
+// result by sampling the traffic. Falls back to the receiver defaults if it can't be confirmed.
+void gps_config_begin(Stream &port);
+
+// Send the sentence pruning and fix rate commands without confirming them.
+// Used to reconfigure a receiver that has been power cycled.
+void gps_config_send(Stream &port);
+
+// Send a UBX binary frame, computing its checksum.
+void gps_send_ubx(Stream &port, uint8_t msg_class, uint8_t msg_id, const uint8_t *payload, uint8_t len);
+
+// Listen to the GPS for sample_ms and return the number of characters received per second.
+// The sentence types seen are returned in *seen_mask (GPS_SENTENCE_xxx bits).
+unsigned int gps_config_sample_traffic(Stream &port, unsigned int sample_ms, uint8_t *seen_mask);
+
+// Send an NMEA sentence stored in flash, adding the leading '$', the checksum and the CR/LF.
+void gps_send_nmea_P(Stream &port, const __FlashStringHelper *body);
+#endif
@@ -0,0 +1,101 @@
+/*
+   GeminiGpsMetrics.cpp - GPS time-to-fix and health counters.
+
+   Collects the numbers needed to tune the GPS power and scheduling policies:
+   time to first fix (after power up or a wake-up) and time to re-fix, each with min/mean/max,
+   the number of gps_fix() attempts that timed out, the NeoGPS parser counters, the character
+   rate on the GPS port and the number of PPS edges seen per minute.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiGpsMetrics.h"
+#include "GeminiSerialMonitor.h"
+
+static struct GpsFixStats g_ttff_stats = {0, 0, 0, 0};   // Time to first fix
+static struct GpsFixStats g_refix_stats = {0, 0, 0, 0};  // Time to re-fix while the GPS kept running
+static uint16_t g_fix_failures = 0;
+static bool g_first_fix_pending = true;                  // Nothing since power up
+
+// Cumulative counters as of the last tick and the rates derived from them
+static unsigned long g_last_tick_ms = 0;
+static uint32_t g_last_nmea_chars = 0;
+static unsigned long g_last_pps_edges = 0;
+static uint32_t g_nmea_ok = 0;
+static uint32_t g_nmea_errors = 0;
+static unsigned int g_chars_per_s = 0;
+static unsigned int g_pps_per_min = 0;
+
+static void update_fix_stats(struct GpsFixStats *stats, unsigned long duration_ms) {
+  if ((stats->count == 0) || (duration_ms < stats->min_ms)) stats->min_ms = duration_ms;
+  if (duration_ms > stats->max_ms) stats->max_ms = duration_ms;
+  stats->total_ms += duration_ms;
+  stats->count++;
+}
+
+void gps_metrics_power_on() {
+  g_first_fix_pending = true;
+}
+
+void gps_metrics_fix_done(unsigned long duration_ms, bool fix_ok) {
+
+  if (!fix_ok) {
+    g_fix_failures++;
+    return;
+  }
+
+  if (g_first_fix_pending) {
+    update_fix_stats(&g_ttff_stats, duration_ms);
+    g_first_fix_pending = false;
+  }
+  else
+    update_fix_stats(&g_refix_stats, duration_ms);
+}
+
+void gps_metrics_tick(uint32_t nmea_chars, uint32_t nmea_ok, uint32_t nmea_errors, unsigned long pps_edges) {
+  unsigned long now_ms = millis();
+  unsigned long elapsed_ms = now_ms - g_last_tick_ms;
+
+  if (elapsed_ms < GPS_METRICS_PERIOD_MS) return;
+
+  g_chars_per_s = ((nmea_chars - g_last_nmea_chars) * 1000UL) / elapsed_ms;
+  g_pps_per_min = ((pps_edges - g_last_pps_edges) * 60000UL) / elapsed_ms;
+  g_nmea_ok = nmea_ok;
+  g_nmea_errors = nmea_errors;
+
+  g_last_nmea_chars = nmea_chars;
+  g_last_pps_edges = pps_edges;
+  g_last_tick_ms = now_ms;
+}
+
+static void log_fix_stats(const char *name, struct GpsFixStats *stats) {
+  char msg[64];
+
+  sprintf(msg, "GPS %s n:%u ms:%lu/%lu/%lu", name, stats->count, stats->min_ms,
+          (stats->count == 0) ? 0UL : stats->total_ms / stats->count, stats->max_ms);
+  gemini_log(msg);
+}
+
+void gps_metrics_dump() {
+  char msg[72];
+
+  log_fix_stats("ttff", &g_ttff_stats);    // min/mean/max
+  log_fix_stats("refix", &g_refix_stats);
+  sprintf(msg, "GPS fail:%u ok:%lu err:%lu cps:%u pps/min:%u", g_fix_failures, (unsigned long)g_nmea_ok,
+          (unsigned long)g_nmea_errors, g_chars_per_s, g_pps_per_min);
+  gemini_log(msg);
+}
@@ -0,0 +1,45 @@
+#ifndef GEMINIGPSMETRICS_H
+#define GEMINIGPSMETRICS_H
+/*
+   GeminiGpsMetrics.h - Definitions for GPS time-to-fix and health counters
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+#define GPS_METRICS_PERIOD_MS  60000   // Rate counters (chars/s, PPS/min) are computed over this period
+
+struct GpsFixStats {
+  uint16_t count;
+  unsigned long min_ms;
+  unsigned long max_ms;
+  unsigned long total_ms;   // mean = total_ms / count
+};
+
+// The GPS has just been powered up or woken up, so the next fix counts as a first fix
+void gps_metrics_power_on();
+
+// Record the outcome of one gps_fix() attempt and how long it took
+void gps_metrics_fix_done(unsigned long duration_ms, bool fix_ok);
+
+// Called from loop(). Once per GPS_METRICS_PERIOD_MS it derives the rates from the cumulative counters.
+// nmea_chars, nmea_ok and nmea_errors are NeoGPS' own statistics, pps_edges the free running PPS edge count.
+void gps_metrics_tick(uint32_t nmea_chars, uint32_t nmea_ok, uint32_t nmea_errors, unsigned long pps_edges);
+
+// Dump all counters in compact form through the serial monitor
+void gps_metrics_dump();
+#endif
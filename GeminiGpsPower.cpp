@@ -0,0 +1,163 @@
+/*
+   GeminiGpsPower.cpp - GPS power saving policy.
+
+   The GPS is by far the largest continuous load on a solar balloon, and between the moment the
+   telemetry for a slot has been captured and the next slot we have no use for it. This puts the
+   receiver to sleep and wakes it up ahead of the next slot, early enough to get a hot start fix.
+
+   Two methods are supported, selected with GPS_POWER_SAVE_MODE in GeminiXConfig.h :
+   GPS_POWER_MODE_RECEIVER - the receiver's own low power state. MTK receivers are put in standby
+                             with PMTK161 and woken up by any byte on their RX line. u-blox receivers
+                             are put in backup with RXM-PMREQ for the requested duration.
+   GPS_POWER_MODE_PIN      - GPS VCC is switched off with GPS_POWER_DISABLE_PIN. Unless the module has
+                             backup power this means a cold start, which the adaptive lead time absorbs.
+
+   The time-to-fix of every wake-up is measured and the lead time follows its running average,
+   doubling whenever a wake-up fails to produce a fix in time.
+   Waking up is only done from loop(), never between WSPR symbols: the GPS is not put to sleep for a WSPR
+   slot whose wake-up would fall inside the transmission.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiXConfig.h"
+#include "GeminiBoardConfig.h"
+#include "GeminiGpsConfig.h"
+#include "GeminiGpsPower.h"
+#include "GeminiGpsMetrics.h"
+#include "GeminiSerialMonitor.h"
+
+#if defined (GPS_POWER_SAVE_MODE)
+
+#if (GPS_POWER_SAVE_MODE == GPS_POWER_MODE_PIN) && !defined (GPS_POWER_DISABLE_SUPPORTED)
+#error "GPS_POWER_MODE_PIN requires a board with GPS_POWER_DISABLE_SUPPORTED"
+#endif
+
+#if (GPS_POWER_SAVE_MODE == GPS_POWER_MODE_RECEIVER) && !defined (GPS_RECEIVER_MTK) && !defined (GPS_RECEIVER_UBLOX)
+#error "GPS_POWER_MODE_RECEIVER requires GPS_RECEIVER_MTK or GPS_RECEIVER_UBLOX in the board configuration"
+#endif
+
+static Stream *g_gps_power_port = NULL;
+static bool g_gps_awake = true;
+static bool g_gps_awaiting_fix = false;       // Woken up, first fix not reported yet
+static unsigned long g_gps_wake_ms = 0;       // millis() at the last wake-up
+static unsigned long g_gps_ttf_avg_ms = 0;    // Running average of the wake-up time-to-fix, 0 until the first one
+static unsigned int g_gps_wake_lead_s = GPS_WAKE_LEAD_INIT_S;
+
+void gps_power_begin(Stream &port) {
+  g_gps_power_port = &port;
+  g_gps_awake = true;
+  g_gps_awaiting_fix = false;
+}
+
+void gps_power_sleep(unsigned int wake_in_s) {
+
+  if ((!g_gps_awake) || (wake_in_s < GPS_MIN_SLEEP_S)) return;
+
+#if (GPS_POWER_SAVE_MODE == GPS_POWER_MODE_PIN)
+  digitalWrite(GPS_POWER_DISABLE_PIN, HIGH);
+#elif defined (GPS_RECEIVER_MTK)
+  gps_send_nmea_P(*g_gps_power_port, F("PMTK161,0")); // Standby, wakes on any byte received
+#elif defined (GPS_RECEIVER_UBLOX)
+  // RXM-PMREQ (0x02 0x41): duration in ms then flags, bit 1 = enter backup mode.
+  // The receiver wakes itself up after the duration so the wake-up byte is only a safety net.
+  unsigned long duration_ms = wake_in_s * 1000UL;
+  uint8_t payload[8] = {(uint8_t)duration_ms, (uint8_t)(duration_ms >> 8), (uint8_t)(duration_ms >> 16), (uint8_t)(duration_ms >> 24),
+                        0x02, 0, 0, 0};
+  gps_send_ubx(*g_gps_power_port, 0x02, 0x41, payload, sizeof(payload));
+#endif
+
+  g_gps_awake = false;
+  g_gps_awaiting_fix = false;
+}
+
+void gps_power_wake() {
+
+  if (g_gps_awake) return;
+
+#if (GPS_POWER_SAVE_MODE == GPS_POWER_MODE_PIN)
+  digitalWrite(GPS_POWER_DISABLE_PIN, LOW);
+
+  // The receiver has been power cycled so it has lost its configuration. Give it time to boot first.
+  delay(1000);
+#if defined (GPS_BALLOON_MODE_COMMAND)
+  g_gps_power_port->print(F(GPS_BALLOON_MODE_COMMAND));
+  delay(250);
+#endif
+#if defined (GPS_RECEIVER_MTK) || defined (GPS_RECEIVER_UBLOX)
+  gps_config_send(*g_gps_power_port);
+#endif
+#else
+  g_gps_power_port->write(0xFF); // Any activity on the receiver RX line ends standby
+#endif
+
+  // Whatever is still buffered was received before the GPS went to sleep and would give us a stale fix
+  while (g_gps_power_port->available()) g_gps_power_port->read();
+
+  g_gps_awake = true;
+  g_gps_awaiting_fix = true;
+  g_gps_wake_ms = millis();
+  gps_metrics_power_on();
+}
+
+void gps_power_poll(unsigned int secs_to_next_slot) {
+  if ((!g_gps_awake) && (secs_to_next_slot <= g_gps_wake_lead_s))
+    gps_power_wake();
+}
+
+bool gps_power_is_awake() {
+  return g_gps_awake;
+}
+
+bool gps_power_fix_pending() {
+  return g_gps_awaiting_fix;
+}
+
+void gps_power_fix_result(bool fix_ok) {
+  unsigned long ttf_ms;
+  char msg[56];
+
+  if (!g_gps_awaiting_fix) return;
+  g_gps_awaiting_fix = false;
+
+  ttf_ms = millis() - g_gps_wake_ms;
+
+  if (fix_ok) {
+    // Running average with a 1/4 weight for the newest sample, seeded with the first one
+    if (g_gps_ttf_avg_ms == 0)
+      g_gps_ttf_avg_ms = ttf_ms;
+    else
+      g_gps_ttf_avg_ms = g_gps_ttf_avg_ms + (long)(ttf_ms - g_gps_ttf_avg_ms) / 4;
+
+    g_gps_wake_lead_s = (g_gps_ttf_avg_ms * 3 / 2) / 1000 + GPS_WAKE_MARGIN_S;
+  }
+  else {
+    // We missed, be more generous next time
+    g_gps_wake_lead_s = g_gps_wake_lead_s * 2;
+  }
+
+  g_gps_wake_lead_s = constrain(g_gps_wake_lead_s, (unsigned int)GPS_WAKE_LEAD_MIN_S, (unsigned int)GPS_WAKE_LEAD_MAX_S);
+
+  sprintf(msg, "GPS wake fix:%d ttf_ms:%lu lead_s:%u", fix_ok, ttf_ms, g_gps_wake_lead_s);
+  gemini_log(msg);
+}
+
+unsigned int gps_power_wake_lead_s() {
+  return g_gps_wake_lead_s;
+}
+
+#endif // GPS_POWER_SAVE_MODE
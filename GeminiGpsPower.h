@@ -0,0 +1,51 @@
+#ifndef GEMINIGPSPOWER_H
+#define GEMINIGPSPOWER_H
+/*
+   GeminiGpsPower.h - Definitions for the GPS power saving policy
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiXConfig.h"
+
+#define GPS_MIN_SLEEP_S       15     // Don't bother putting the GPS to sleep for less than this
+#define GPS_WAKE_MARGIN_S     3      // Added to the average time-to-fix to get the wake-up lead time
+
+void gps_power_begin(Stream &port);
+
+// Put the GPS to sleep, to be woken up wake_in_s seconds from now (i.e. the lead time before the next slot)
+void gps_power_sleep(unsigned int wake_in_s);
+
+// Wake the GPS up now. Does nothing if it is already awake.
+// With GPS_POWER_MODE_PIN this blocks for over a second while the receiver boots and is configured again,
+// never call it during a transmission.
+void gps_power_wake();
+
+// Wakes the GPS once the next slot is within the wake-up lead time, from loop() only, see gps_power_wake()
+void gps_power_poll(unsigned int secs_to_next_slot);
+
+bool gps_power_is_awake();
+
+// True after a wake-up until gps_power_fix_result() is called
+bool gps_power_fix_pending();
+
+// Report the outcome of the first fix attempt after a wake-up. The time-to-fix is recorded
+// and used to adapt the wake-up lead time.
+void gps_power_fix_result(bool fix_ok);
+
+unsigned int gps_power_wake_lead_s();
+#endif
@@ -0,0 +1,79 @@
+/*
+   GeminiLocator.cpp - Maidenhead locator from an integer position
+
+   The locator is worked out on the position in 10^-7 degree units that the GPS parser produces, with
+   32 bit integer division only. Each pair of characters divides what is left of the previous one:
+
+     field       20 x 10 degrees     A-R
+     square       2 x  1 degree      0-9
+     subsquare   24 x 24 per square  A-X
+     extended    10 x 10 per subsq.  0-9
+
+   A subsquare is not a whole number of 10^-7 degrees, so the remainder is scaled by 24 instead of
+   dividing by the subsquare size, and the same for the extended square. Every step is then exact, the
+   locator is the floor of the position at each level, which float arithmetic doesn't get right on the
+   boundaries.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiLocator.h"
+
+#define LOCATOR_DEG_E7  10000000L
+
+// Characters for one axis, span_e7 is the size of a field in 10^-7 degrees (20 degrees of longitude,
+// 10 of latitude), value_e7 the offset from -180 or -90 and must be below 18 fields.
+static void locator_axis(uint32_t value_e7, uint32_t span_e7, char locator[], uint8_t chars) {
+  uint32_t square_e7 = span_e7 / 10;
+
+  locator[0] = 'A' + (uint8_t)(value_e7 / span_e7);
+  value_e7 %= span_e7;
+  locator[2] = '0' + (uint8_t)(value_e7 / square_e7);
+  value_e7 %= square_e7;
+  if (chars < 6) return;
+
+  value_e7 *= 24;                                  // In 1/24 of 10^-7 degrees, below 4.8 * 10^8
+  locator[4] = 'A' + (uint8_t)(value_e7 / square_e7);
+  value_e7 %= square_e7;
+  if (chars < 8) return;
+
+  value_e7 *= 10;                                  // In 1/240 of 10^-7 degrees, below 2 * 10^8
+  locator[6] = '0' + (uint8_t)(value_e7 / square_e7);
+}
+
+void maidenhead_locator(int32_t latitude_e7, int32_t longitude_e7, char locator[], uint8_t chars) {
+  uint32_t lat, lon;
+
+  // Whole pairs of characters only, 5 and 7 are rounded down. Less than a square is no locator at all.
+  if (chars > LOCATOR_MAX_CHARS) chars = LOCATOR_MAX_CHARS;
+  chars &= ~1;
+  if (chars < 4) {
+    locator[0] = '\0';
+    return;
+  }
+
+  // Offset from the south pole and from -180, up to 1.8 * 10^9 and 3.6 * 10^9 which only fit unsigned.
+  // +90 and +180 are the edge of the grid, they are moved onto the last square rather than one beyond it.
+  lat = (uint32_t)constrain(latitude_e7, -90 * LOCATOR_DEG_E7, 90 * LOCATOR_DEG_E7) + 90UL * LOCATOR_DEG_E7;
+  lon = (uint32_t)constrain(longitude_e7, -180 * LOCATOR_DEG_E7, 180 * LOCATOR_DEG_E7) + 180UL * LOCATOR_DEG_E7;
+  if (lat >= 180UL * LOCATOR_DEG_E7) lat = 180UL * LOCATOR_DEG_E7 - 1;
+  if (lon >= 360UL * LOCATOR_DEG_E7) lon = 360UL * LOCATOR_DEG_E7 - 1;
+
+  locator_axis(lon, 20UL * LOCATOR_DEG_E7, locator, chars);
+  locator_axis(lat, 10UL * LOCATOR_DEG_E7, locator + 1, chars);
+  locator[chars] = '\0';
+}
@@ -0,0 +1,31 @@
+#ifndef GEMINILOCATOR_H
+#define GEMINILOCATOR_H
+/*
+   GeminiLocator.h - Maidenhead locator from an integer position
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+#define LOCATOR_MAX_CHARS  8
+
+// Maidenhead locator of 4, 6 or 8 characters, i.e. FN31, FN31PR or FN31PR21, into locator[chars + 1].
+// Latitude and longitude are in degrees * 10^7 as NeoGPS latitudeL() and longitudeL() return them,
+// west and south negative. The north pole and the antimeridian (+180) fall in the last square.
+// An odd chars is rounded down to a whole pair, below 4 locator is left empty.
+void maidenhead_locator(int32_t latitude_e7, int32_t longitude_e7, char locator[], uint8_t chars);
+#endif
@@ -0,0 +1,82 @@
+#ifndef GEMINILOGRECORD_H
+#define GEMINILOGRECORD_H
+/*
+   GeminiLogRecord.h - Binary log records of the serial monitor
+
+   With the binary log on, the telemetry, TX, calibration and state machine logs are sent as frames instead
+   of text lines:
+
+     LOG_SYNC_1 LOG_SYNC_2 type length payload crc_lo crc_hi
+
+   The CRC is the CRC-16 of _crc16_update() (0xA001, starting from 0xFFFF) over type, length and the payload.
+   The payloads are the structs below, little endian and without padding. Anything between frames is text,
+   the other logs are unchanged. tools/log_decode prints both. This file is shared with the decoder so it only
+   relies on stdint.h.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+
+#define LOG_SYNC_1  0xA5
+#define LOG_SYNC_2  0x5A
+
+enum LogRecordType {LOG_REC_TELEMETRY = 1, LOG_REC_WSPR_TX, LOG_REC_CALIBRATION, LOG_REC_STATE};
+
+// gemini_log_telemetry(), the snapshot as sampled
+struct __attribute__((packed)) LogTelemetry {
+  uint32_t time;
+  uint16_t sequence;
+  uint8_t valid;                // TELEM_VALID() bits
+  int32_t latitude_e7;
+  int32_t longitude_e7;
+  int32_t altitude_cm;
+  uint32_t speed_mkn;
+  uint8_t number_of_sats;
+  uint8_t gps_status;
+  int16_t temperature_c;
+  int16_t processor_temperature_c;
+  uint8_t battery_voltage_v_x10;
+};
+
+// gemini_log_wspr_tx(), the message as encoded. Strings are NUL padded, not terminated when full.
+struct __attribute__((packed)) LogWsprTx {
+  uint32_t time;
+  uint32_t freq_hz;
+  uint8_t pwr_dbm;
+  char call[12];
+  char grid[6];
+};
+
+// gemini_log_calibration(), a finished CalibrationResult without its rounds
+struct __attribute__((packed)) LogCalibration {
+  uint32_t time;
+  int32_t correction;           // ppb
+  int32_t residual_ppb;
+  uint16_t duration_s;
+  uint8_t gates;
+  uint8_t status;               // enum CalibrationStatus
+  int8_t temperature_c;
+};
+
+// gemini_sm_trace_post(), an event processed by the state machine
+struct __attribute__((packed)) LogState {
+  uint32_t time;
+  uint8_t state;                // After the event
+  uint8_t event;
+  uint8_t action;
+};
+#endif
@@ -0,0 +1,186 @@
+/*
+   GeminiNmeaTime.cpp - Minimal time-only NMEA parser used for the periodic clock resync.
+
+   Resyncing the Arduino clock only needs UTC time and date, not a full position fix, so rather
+   than running the complete NeoGPS fix this picks the time and date fields out of the first valid
+   RMC or ZDA sentence. Only the fields we need are buffered and the checksum is verified.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiNmeaTime.h"
+
+enum NmeaTimeParserState {NMEA_IDLE, NMEA_BODY, NMEA_CHECKSUM_HI, NMEA_CHECKSUM_LO};
+enum NmeaTimeSentence {NMEA_UNKNOWN, NMEA_RMC, NMEA_ZDA};
+
+#define NMEA_GOT_TIME    0x01
+#define NMEA_GOT_DATE    0x02
+#define NMEA_GOT_STATUS  0x04   // RMC status is A (valid)
+#define NMEA_GOT_DAY     0x08   // ZDA carries the date in three separate fields
+#define NMEA_GOT_MONTH   0x10
+
+static NmeaTimeParserState g_nmea_state = NMEA_IDLE;
+static NmeaTimeSentence g_nmea_sentence = NMEA_UNKNOWN;
+static char g_nmea_field[11];
+static uint8_t g_nmea_field_len = 0;
+static uint8_t g_nmea_field_num = 0;
+static uint8_t g_nmea_checksum = 0;
+static uint8_t g_nmea_rx_checksum = 0;
+static uint8_t g_nmea_got = 0;
+static struct NmeaTime g_nmea_time;
+
+void nmea_time_reset() {
+  g_nmea_state = NMEA_IDLE;
+}
+
+static bool is_digits(const char *p, uint8_t n) {
+  while (n--) {
+    if ((*p < '0') || (*p > '9')) return false;
+    p++;
+  }
+  return true;
+}
+
+static uint8_t two_digits(const char *p) {
+  return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+static int8_t hex_value(char c) {
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+  return -1;
+}
+
+// A field has been completed, pick out what we need. Returns false to abandon the sentence.
+static bool nmea_time_field_done() {
+  char *f = g_nmea_field;
+
+  f[g_nmea_field_len] = '\0';
+
+  if (g_nmea_field_num == 0) {
+    // Address field, i.e. GPRMC or GNZDA. The talker ID doesn't matter.
+    if (g_nmea_field_len != 5) return false;
+    if (strcmp(f + 2, "RMC") == 0)
+      g_nmea_sentence = NMEA_RMC;
+    else if (strcmp(f + 2, "ZDA") == 0)
+      g_nmea_sentence = NMEA_ZDA;
+    else
+      return false;
+    return true;
+  }
+
+  // hhmmss[.ss] is field 1 for both sentences
+  if (g_nmea_field_num == 1) {
+    if ((g_nmea_field_len >= 6) && is_digits(f, 6)) {
+      g_nmea_time.hours = two_digits(f);
+      g_nmea_time.minutes = two_digits(f + 2);
+      g_nmea_time.seconds = two_digits(f + 4);
+      g_nmea_got |= NMEA_GOT_TIME;
+    }
+    return true;
+  }
+
+  if (g_nmea_sentence == NMEA_RMC) {
+    if ((g_nmea_field_num == 2) && (f[0] == 'A'))
+      g_nmea_got |= NMEA_GOT_STATUS;
+    else if ((g_nmea_field_num == 9) && (g_nmea_field_len == 6) && is_digits(f, 6)) {
+      // ddmmyy
+      g_nmea_time.day = two_digits(f);
+      g_nmea_time.month = two_digits(f + 2);
+      g_nmea_time.year = 2000 + two_digits(f + 4);
+      g_nmea_got |= NMEA_GOT_DATE;
+    }
+  }
+  else {
+    // ZDA: dd, mm and yyyy in fields 2, 3 and 4
+    if ((g_nmea_field_num == 2) && (g_nmea_field_len == 2) && is_digits(f, 2)) {
+      g_nmea_time.day = two_digits(f);
+      g_nmea_got |= NMEA_GOT_DAY;
+    }
+    else if ((g_nmea_field_num == 3) && (g_nmea_field_len == 2) && is_digits(f, 2)) {
+      g_nmea_time.month = two_digits(f);
+      g_nmea_got |= NMEA_GOT_MONTH;
+    }
+    else if ((g_nmea_field_num == 4) && (g_nmea_field_len == 4) && is_digits(f, 4)) {
+      g_nmea_time.year = two_digits(f) * 100 + two_digits(f + 2);
+      if ((g_nmea_got & (NMEA_GOT_DAY | NMEA_GOT_MONTH)) == (NMEA_GOT_DAY | NMEA_GOT_MONTH))
+        g_nmea_got |= NMEA_GOT_DATE;
+    }
+  }
+  return true;
+}
+
+bool nmea_time_feed(char c, struct NmeaTime *t) {
+  int8_t nibble;
+
+  if (c == '$') {
+    // Start of a new sentence, whatever we were doing
+    g_nmea_state = NMEA_BODY;
+    g_nmea_sentence = NMEA_UNKNOWN;
+    g_nmea_field_len = 0;
+    g_nmea_field_num = 0;
+    g_nmea_checksum = 0;
+    g_nmea_got = 0;
+    return false;
+  }
+
+  switch (g_nmea_state) {
+
+    case NMEA_IDLE :
+      break;
+
+    case NMEA_BODY :
+      if (c == '*') {
+        g_nmea_state = nmea_time_field_done() ? NMEA_CHECKSUM_HI : NMEA_IDLE;
+        break;
+      }
+      g_nmea_checksum ^= c;
+      if (c == ',') {
+        if (!nmea_time_field_done()) {
+          g_nmea_state = NMEA_IDLE; // Not a sentence we care about, skip the rest of it
+          break;
+        }
+        g_nmea_field_num++;
+        g_nmea_field_len = 0;
+      }
+      else if (g_nmea_field_len < sizeof(g_nmea_field) - 1)
+        g_nmea_field[g_nmea_field_len++] = c;
+      break;
+
+    case NMEA_CHECKSUM_HI :
+      nibble = hex_value(c);
+      if (nibble < 0) {
+        g_nmea_state = NMEA_IDLE;
+        break;
+      }
+      g_nmea_rx_checksum = nibble << 4;
+      g_nmea_state = NMEA_CHECKSUM_LO;
+      break;
+
+    case NMEA_CHECKSUM_LO :
+      g_nmea_state = NMEA_IDLE;
+      nibble = hex_value(c);
+      if ((nibble < 0) || ((g_nmea_rx_checksum | nibble) != g_nmea_checksum)) break;
+
+      if ((g_nmea_got & (NMEA_GOT_TIME | NMEA_GOT_DATE)) != (NMEA_GOT_TIME | NMEA_GOT_DATE)) break;
+      if ((g_nmea_sentence == NMEA_RMC) && !(g_nmea_got & NMEA_GOT_STATUS)) break;
+
+      *t = g_nmea_time;
+      return true;
+  }
+  return false;
+}
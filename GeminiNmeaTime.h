@@ -0,0 +1,40 @@
+#ifndef GEMININMEATIME_H
+#define GEMININMEATIME_H
+/*
+   GeminiNmeaTime.h - Definitions for the time-only NMEA parser
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+struct NmeaTime {
+  uint8_t hours;
+  uint8_t minutes;
+  uint8_t seconds;
+  uint8_t day;
+  uint8_t month;
+  uint16_t year;   // Four digits
+};
+
+// Forget any partially received sentence
+void nmea_time_reset();
+
+// Feed one character from the GPS. Returns true when it completes a valid RMC (status A) or ZDA
+// sentence carrying both UTC time and date, which is then copied to *t.
+// Every other sentence is skipped as soon as its address field has been read.
+bool nmea_time_feed(char c, struct NmeaTime *t);
+#endif
@@ -0,0 +1,108 @@
+/*
+   GeminiPark.cpp - Thermal control of the Si5351 with the PARK clock.
+
+   Between transmissions the PARK clock keeps the Si5351 die warm, so that it doesn't heat up and drift once the
+   TX clock comes on (the PARK feature of the QRP Labs U3S). With PARK_THERMAL_CONTROL the power put into
+   the PARK clock follows the measured temperature: a set of levels of decreasing frequency and drive, from
+   PARK_FREQ_HZ at 8 mA down to off, one level per PARK_C_PER_LEVEL below PARK_SETPOINT_C. The level moves by
+   one step per slot, and it is off altogether above the setpoint or on a low battery.
+   When a transmission starts the PARK clock is stepped down over its first symbols, instead of being switched
+   off at the very moment the TX clock comes on, to soften the thermal step.
+
+   Without PARK_THERMAL_CONTROL the PARK clock runs at PARK_FREQ_HZ and 8 mA and is switched off for TX.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "GeminiXConfig.h"
+#include "GeminiBoardConfig.h"
+#include "GeminiSi5351.h"
+#include "GeminiPark.h"
+
+struct ParkLevel {
+  uint8_t divider;   // Of PARK_FREQ_HZ, 0 is off
+  uint8_t drive;     // 0=2ma 1=4ma 2=6ma 3=8ma
+};
+
+static const struct ParkLevel g_park_levels[PARK_LEVELS] = {
+  {0, 0}, {4, 0}, {2, 0}, {2, 1}, {1, 1}, {1, 2}, {1, 3}
+};
+
+static uint8_t g_park_level = PARK_MAX_LEVEL;   // Level between transmissions
+static uint8_t g_park_output = 0;               // Level the clock is at right now
+
+static void park_set(uint8_t level) {
+  g_park_output = level;
+  if (level == 0) {
+    si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+    return;
+  }
+  si5351bx_set_drive(SI5351A_PARK_CLK_NUM, g_park_levels[level].drive);
+  si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL) / g_park_levels[level].divider);
+}
+
+void park_on() {
+  park_set(g_park_level);
+}
+
+void park_off() {
+  park_set(0);
+}
+
+void park_update(int temperature_c, uint8_t battery_voltage_v_x10) {
+#if defined (PARK_THERMAL_CONTROL)
+  uint8_t target;
+
+#if PARK_MIN_BATTERY_V_X10 > 0
+  if (battery_voltage_v_x10 < PARK_MIN_BATTERY_V_X10)
+    target = 0;
+  else
+#else
+  (void)battery_voltage_v_x10;
+#endif
+  if (temperature_c >= PARK_SETPOINT_C)
+    target = 0;
+  else
+    target = min(PARK_MAX_LEVEL, 1 + (PARK_SETPOINT_C - temperature_c) / PARK_C_PER_LEVEL);
+
+  // One level per slot so the die temperature moves gradually
+  if (target > g_park_level)
+    g_park_level++;
+  else if (target < g_park_level)
+    g_park_level--;
+#else
+  (void)temperature_c;
+  (void)battery_voltage_v_x10;
+#endif
+}
+
+void park_tx_start() {
+#if !defined (PARK_THERMAL_CONTROL)
+  park_off();
+#endif
+}
+
+void park_tx_symbol(uint8_t symbol) {
+#if defined (PARK_THERMAL_CONTROL)
+  if ((g_park_output > 0) && (((symbol + 1) % PARK_RAMP_SYMBOLS_PER_LEVEL) == 0)) park_set(g_park_output - 1);
+#else
+  (void)symbol;
+#endif
+}
+
+uint8_t park_level() {
+  return g_park_level;
+}
@@ -0,0 +1,39 @@
+#ifndef GEMINIPARK_H
+#define GEMINIPARK_H
+/*
+   GeminiPark.h - Definitions for the thermal control of the Si5351 with the PARK clock
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+#define PARK_LEVELS     7                    // 0 is off, PARK_MAX_LEVEL is PARK_FREQ_HZ at 8 mA
+#define PARK_MAX_LEVEL  (PARK_LEVELS - 1)
+
+// Turn the PARK clock on at the current level, or off
+void park_on();
+void park_off();
+
+// Pick the level for the next slot from the measured temperature and the battery voltage
+void park_update(int temperature_c, uint8_t battery_voltage_v_x10);
+
+// A transmission is starting. The PARK clock is stepped down over its first symbols rather than switched off at once.
+void park_tx_start();
+void park_tx_symbol(uint8_t symbol);
+
+uint8_t park_level();
+#endif
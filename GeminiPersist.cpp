@@ -0,0 +1,102 @@
+/*
+   GeminiPersist.cpp - Calibration and clock state kept in EEPROM across power cycles.
+
+   A brown-out or a power cycle is common on solar balloons at sunrise. Rather than starting again from the
+   compile time SI5351A_CLK_FREQ_CORRECTION, the state learned in flight is saved and restored on boot.
+
+   The EEPROM holds PERSIST_SLOTS records used in turn to spread the wear. Each record has a version,
+   a sequence number and a CRC, on boot the valid record with the highest sequence number wins.
+   A record that was half written when the power went away fails its CRC and the previous one is used.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "GeminiPersist.h"
+#include "GeminiRecorder.h"
+
+struct PersistRecord {
+  uint8_t version;
+  uint16_t sequence;
+  struct PersistState state;
+  uint16_t crc;           // Over everything above
+};
+
+static_assert(PERSIST_EEPROM_BASE + PERSIST_SLOTS * sizeof(struct PersistRecord) <= E2END + 1,
+              "The persisted state doesn't fit in the EEPROM");
+#if defined (FLIGHT_RECORDER)
+static_assert(PERSIST_EEPROM_BASE + PERSIST_SLOTS * sizeof(struct PersistRecord) <= RECORDER_EEPROM_BASE,
+              "The persisted state runs into the flight recorder");
+#endif
+
+static uint8_t g_persist_slot = PERSIST_SLOTS - 1;   // Last slot written, the next save goes to the one after
+static uint16_t g_persist_sequence = 0;
+static uint16_t g_persist_crc = 0;                   // CRC of the last record written or loaded
+
+static uint16_t persist_crc(const struct PersistRecord *record) {
+  const uint8_t *p = (const uint8_t *)record;
+  uint16_t crc = 0xFFFF;
+  uint16_t i;
+
+  for (i = 0; i < offsetof(struct PersistRecord, crc); i++) crc = _crc16_update(crc, p[i]);
+  return crc;
+}
+
+static uint8_t *persist_address(uint8_t slot) {
+  return (uint8_t *)(PERSIST_EEPROM_BASE + (uint16_t)slot * sizeof(struct PersistRecord));
+}
+
+bool persist_load(struct PersistState *state) {
+  struct PersistRecord record;
+  bool found = false;
+  uint8_t slot;
+
+  for (slot = 0; slot < PERSIST_SLOTS; slot++) {
+    eeprom_read_block(&record, persist_address(slot), sizeof(record));
+    if ((record.version != PERSIST_VERSION) || (record.crc != persist_crc(&record))) continue;
+
+    // The sequence number wraps, newer means ahead by less than half the range
+    if (found && ((int16_t)(record.sequence - g_persist_sequence) <= 0)) continue;
+
+    found = true;
+    g_persist_slot = slot;
+    g_persist_sequence = record.sequence;
+    g_persist_crc = record.crc;
+    *state = record.state;
+  }
+  return found;
+}
+
+void persist_save(const struct PersistState *state) {
+  struct PersistRecord record;
+
+  memset(&record, 0, sizeof(record)); // Padding is covered by the CRC too
+  record.version = PERSIST_VERSION;
+  record.sequence = g_persist_sequence;
+  record.state = *state;
+
+  // Nothing has changed since the last save, spare the EEPROM
+  if (persist_crc(&record) == g_persist_crc) return;
+
+  record.sequence = ++g_persist_sequence;
+  record.crc = persist_crc(&record);
+
+  g_persist_slot = (g_persist_slot + 1) % PERSIST_SLOTS;
+  eeprom_update_block(&record, persist_address(g_persist_slot), sizeof(record));
+  g_persist_crc = record.crc;
+}
@@ -0,0 +1,42 @@
+#ifndef GEMINIPERSIST_H
+#define GEMINIPERSIST_H
+/*
+   GeminiPersist.h - Definitions for the calibration and clock state kept in EEPROM across power cycles
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "GeminiXConfig.h"
+#include "GeminiCalModel.h"
+
+#define PERSIST_VERSION  2    // Bump whenever struct PersistState changes, older records are then ignored
+
+struct PersistState {
+  int32_t cal_factor;                         // Si5351 correction in ppb
+  int32_t mcu_clock_error_ppb;                // Processor clock against the GPS PPS
+  int32_t latitude_e7;                        // Last known position in degrees * 10^7
+  int32_t longitude_e7;
+  int32_t altitude_cm;
+  struct CalModelEntry cal_model[CAL_MODEL_BUCKETS];
+};
+
+// Load the most recent valid record. Returns false if there is none (blank EEPROM, version change).
+bool persist_load(struct PersistState *state);
+
+// Write state to the next slot, unless it is identical to what was last written
+void persist_save(const struct PersistState *state);
+#endif
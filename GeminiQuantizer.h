@@ -0,0 +1,66 @@
+#ifndef GEMINIQUANTIZER_H
+#define GEMINIQUANTIZER_H
+/*
+   GeminiQuantizer.h - Table driven quantizer for the telemetry encoders
+
+   A quantizer is an ascending table of breakpoints in flash, each one the lowest value of the next
+   bucket. The bucket of a value is found by a binary search, so a table of N breakpoints takes at most
+   log2(N + 1) comparisons where a case-range switch is a ladder of up to N of them.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+
+// Read one breakpoint from flash
+static inline uint8_t quantizer_read_P(const uint8_t *p) {
+  return pgm_read_byte(p);
+}
+
+static inline int8_t quantizer_read_P(const int8_t *p) {
+  return (int8_t)pgm_read_byte(p);
+}
+
+static inline uint16_t quantizer_read_P(const uint16_t *p) {
+  return pgm_read_word(p);
+}
+
+static inline int16_t quantizer_read_P(const int16_t *p) {
+  return (int16_t)pgm_read_word(p);
+}
+
+// For a static_assert on the tables: breakpoints must be strictly ascending
+template <typename T, uint8_t N>
+constexpr bool quantizer_ascending(const T (&breakpoints)[N], uint8_t i = 1) {
+  return (i >= N) || ((breakpoints[i - 1] < breakpoints[i]) && quantizer_ascending(breakpoints, i + 1));
+}
+
+// Bucket of value, from 0 below the first breakpoint to N at or above the last one.
+// This is the number of breakpoints that are <= value.
+template <typename T, uint8_t N>
+uint8_t quantize_P(const T (&breakpoints)[N], T value) {
+  uint8_t lo = 0, hi = N, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (quantizer_read_P(&breakpoints[mid]) <= value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+#endif
@@ -0,0 +1,208 @@
+/*
+   GeminiRecorder.cpp - Flight recorder, telemetry history in EEPROM
+
+   The recorder is RECORDER_BLOCKS blocks of RECORDER_BLOCK_SIZE bytes at the top of the EEPROM, used in turn.
+   A block starts with a key sample, which holds absolute values and the sequence number of the block. The
+   samples after it are differences to the one before. Every value is a variable length integer, 7 bits per
+   byte with the top bit set on all but the last byte. Signed values are zigzag encoded first, so small
+   differences of either sign take one byte.
+
+     key sample     tag (RECORDER_TAG_KEY | valid)  sequence (2 bytes, little endian)  values
+     delta sample   tag (valid)                     differences to the previous sample
+     values         time (s), latitude and longitude (degrees * 10^5), altitude (m), temperature (C),
+                    battery (V * 10), satellites, Si5351 correction (ppb)
+
+   valid is the TELEM_VALID() bits of the snapshot. A tag never has its top bit set, a 0xFF where a tag
+   would be is the end of the block.
+
+   A sample is written a byte at a time from recorder_poll() as the EEPROM becomes ready, so a sample costs
+   no waiting at all. Its tag goes in last, over the 0xFF that ended the block until then, so a sample that
+   was cut short by a reset is never read back. A block about to be reused is first ended at its first byte.
+   The blocks are written in turn and each byte at most twice per turn, the wear is spread over the whole
+   recorder.
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <TimeLib.h>
+#include "GeminiRecorder.h"
+#include "GeminiSerialMonitor.h"
+
+#define RECORDER_TAG_KEY     0x40
+#define RECORDER_TAG_END     0xFF
+#define RECORDER_MAX_SAMPLE  36     // Key sample with every value at its longest
+
+static_assert(RECORDER_EEPROM_BASE >= 0, "The flight recorder doesn't fit in the EEPROM");
+static_assert(RECORDER_BLOCK_SIZE > RECORDER_MAX_SAMPLE, "A block must hold at least a key sample");
+
+// The last sample recorded, the next one is encoded against it
+struct RecorderSample {
+  uint32_t time;
+  int32_t latitude_e5;
+  int32_t longitude_e5;
+  int32_t altitude_m;
+  int16_t temperature_c;
+  uint8_t battery_voltage_v_x10;
+  uint8_t number_of_sats;
+  int32_t cal_factor;
+};
+
+static struct RecorderSample g_recorder_last;
+static bool g_recorder_open = false;          // A block has been started since the power up
+static uint8_t g_recorder_block = RECORDER_BLOCKS - 1;
+static uint8_t g_recorder_offset = 0;         // Of the next sample in the block
+static uint16_t g_recorder_sequence = 0;
+
+// The sample being written by recorder_poll()
+static uint8_t g_recorder_buffer[RECORDER_MAX_SAMPLE + 1];  // With the end of the block after it
+static uint8_t g_recorder_length = 0;         // 0 when there is nothing to write
+static uint8_t g_recorder_step = 0;
+static uint8_t *g_recorder_address;
+
+static uint8_t *recorder_address(uint8_t block, uint8_t offset) {
+  return (uint8_t *)(uintptr_t)(RECORDER_EEPROM_BASE + (uint16_t)block * RECORDER_BLOCK_SIZE + offset);
+}
+
+void recorder_begin() {
+  uint8_t block, tag;
+  uint16_t sequence;
+  bool found = false;
+
+  for (block = 0; block < RECORDER_BLOCKS; block++) {
+    tag = eeprom_read_byte(recorder_address(block, 0));
+    if ((tag & 0xC0) != RECORDER_TAG_KEY) continue;
+
+    sequence = eeprom_read_byte(recorder_address(block, 1)) | (eeprom_read_byte(recorder_address(block, 2)) << 8);
+
+    // The sequence number wraps, newer means ahead by less than half the range
+    if (found && ((int16_t)(sequence - g_recorder_sequence) <= 0)) continue;
+
+    found = true;
+    g_recorder_block = block;
+    g_recorder_sequence = sequence;
+  }
+  g_recorder_open = false;
+}
+
+static uint8_t put_varint(uint8_t *p, uint32_t value) {
+  uint8_t n = 0;
+
+  while (value >= 0x80) {
+    p[n++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  p[n++] = (uint8_t)value;
+  return n;
+}
+
+static uint8_t put_signed(uint8_t *p, int32_t value) {
+  return put_varint(p, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+// Encode sample into g_recorder_buffer, against g_recorder_last unless it is a key sample. Returns the length.
+static uint8_t recorder_encode(const struct RecorderSample *sample, uint8_t valid, bool key) {
+  const struct RecorderSample zero = {0, 0, 0, 0, 0, 0, 0, 0};
+  const struct RecorderSample *last = key ? &zero : &g_recorder_last;
+  uint8_t *p = g_recorder_buffer;
+
+  *p++ = valid | (key ? RECORDER_TAG_KEY : 0);
+  if (key) {
+    *p++ = (uint8_t)g_recorder_sequence;
+    *p++ = (uint8_t)(g_recorder_sequence >> 8);
+  }
+  p += put_varint(p, sample->time - last->time);
+  p += put_signed(p, sample->latitude_e5 - last->latitude_e5);
+  p += put_signed(p, sample->longitude_e5 - last->longitude_e5);
+  p += put_signed(p, sample->altitude_m - last->altitude_m);
+  p += put_signed(p, sample->temperature_c - last->temperature_c);
+  p += put_signed(p, (int16_t)sample->battery_voltage_v_x10 - last->battery_voltage_v_x10);
+  p += put_signed(p, (int16_t)sample->number_of_sats - last->number_of_sats);
+  p += put_signed(p, sample->cal_factor - last->cal_factor);
+  return p - g_recorder_buffer;
+}
+
+void recorder_sample(const struct GeminiTelemetryData *telemetry, int32_t cal_factor) {
+  struct RecorderSample sample;
+  uint8_t length;
+
+  // Without the time the sample can't be placed in the flight, and the last one is still being written
+  if ((timeStatus() == timeNotSet) || (g_recorder_length != 0)) return;
+  if (g_recorder_open && (telemetry->time - g_recorder_last.time < RECORDER_INTERVAL_S)) return;
+
+  sample.time = telemetry->time;
+  sample.latitude_e5 = telemetry->latitude_e7 / 100;
+  sample.longitude_e5 = telemetry->longitude_e7 / 100;
+  sample.altitude_m = telemetry->altitude_cm / 100;
+  sample.temperature_c = telemetry->temperature_c;
+  sample.battery_voltage_v_x10 = telemetry->battery_voltage_v_x10;
+  sample.number_of_sats = telemetry->number_of_sats;
+  sample.cal_factor = cal_factor;
+
+  length = g_recorder_open ? recorder_encode(&sample, telemetry->valid, false) : 0;
+  if ((length == 0) || (g_recorder_offset + length > RECORDER_BLOCK_SIZE)) {
+    // Start the next block, over the oldest one
+    g_recorder_block = (g_recorder_block + 1) % RECORDER_BLOCKS;
+    g_recorder_offset = 0;
+    g_recorder_sequence++;
+    g_recorder_open = true;
+    length = recorder_encode(&sample, telemetry->valid, true);
+  }
+
+  g_recorder_address = recorder_address(g_recorder_block, g_recorder_offset);
+  g_recorder_offset += length;
+  if (g_recorder_offset < RECORDER_BLOCK_SIZE) g_recorder_buffer[length++] = RECORDER_TAG_END;
+
+  g_recorder_last = sample;
+  g_recorder_step = 0;
+  g_recorder_length = length;
+}
+
+void recorder_poll() {
+  uint8_t *address = g_recorder_address;
+
+  if ((g_recorder_length == 0) || !eeprom_is_ready()) return;
+
+  // End the block at the sample, write everything after its tag, then the tag
+  if (g_recorder_step == 0)
+    eeprom_update_byte(address, RECORDER_TAG_END);
+  else if (g_recorder_step < g_recorder_length)
+    eeprom_update_byte(address + g_recorder_step, g_recorder_buffer[g_recorder_step]);
+  else {
+    eeprom_update_byte(address, g_recorder_buffer[0]);
+    g_recorder_length = 0;
+    return;
+  }
+  g_recorder_step++;
+}
+
+void recorder_dump() {
+  char line[80];
+  uint16_t offset;
+  uint8_t i, n;
+
+  sprintf(line, "REC v%u blocks:%u size:%u", RECORDER_VERSION, RECORDER_BLOCKS, RECORDER_BLOCK_SIZE);
+  gemini_print(line);
+
+  // 32 bytes a line, each line starts with its offset in the recorder
+  for (offset = 0; offset < RECORDER_BLOCKS * RECORDER_BLOCK_SIZE; offset += 32) {
+    n = sprintf(line, "REC %04X ", offset);
+    for (i = 0; (i < 32) && (offset + i < RECORDER_BLOCKS * RECORDER_BLOCK_SIZE); i++)
+      n += sprintf(line + n, "%02X", eeprom_read_byte(recorder_address(0, 0) + offset + i));
+    gemini_print(line);
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef GEMINIRECORDER_H
+#define GEMINIRECORDER_H
+/*
+   GeminiRecorder.h - Definitions for the flight recorder, telemetry history in EEPROM
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include "GeminiXConfig.h"
+
+#define RECORDER_EEPROM_BASE  (E2END + 1 - RECORDER_BLOCKS * RECORDER_BLOCK_SIZE)
+#define RECORDER_VERSION      1      // Of the sample encoding, in the dump header
+
+// Find where the recording left off before the power cycle, the next sample starts a new block
+void recorder_begin();
+
+// Record the snapshot if RECORDER_INTERVAL_S have passed since the last sample. Only encodes it, the
+// EEPROM is written a byte at a time by recorder_poll().
+void recorder_sample(const struct GeminiTelemetryData *telemetry, int32_t cal_factor);
+
+// Call from loop(), writes the next byte of a sample once the EEPROM is ready, never waits for it
+void recorder_poll();
+
+// The whole recorder as hex through the serial monitor, for tools/recorder_decode
+void recorder_dump();
+#endif
@@ -19,7 +19,14 @@
 #include "GeminiSerialMonitor.h"
 #include "GeminiXConfig.h"
 #include "GeminiBoardConfig.h"
+#include "GeminiTelemetry.h"
+#include "GeminiCalibration.h"
+#include "GeminiLogRecord.h"
+#include "GeminiGpsMetrics.h"
+#include "GeminiCalModel.h"
+#include "GeminiRecorder.h"
 #include <TimeLib.h>
+#include <util/crc16.h>
 #define OFF false
 #define ON true
 #if defined (DEBUG_USES_SW_SERIAL)
@@ -67,6 +74,11 @@ static bool g_txlog_on_off = ON;
 static bool g_info_log_on_off = ON;
 static bool g_qrm_avoidance_on_off = ON;
 static bool g_selfcalibration_on_off = ON;
+#if defined (MONITOR_BINARY_LOG)
+static bool g_binary_log_on_off = ON;
+#else
+static bool g_binary_log_on_off = OFF;
+#endif
  
 #if defined (DEBUG_USES_SW_SERIAL)  
   NeoSWSerial debugSerial(SOFT_SERIAL_RX_PIN, SOFT_SERIAL_TX_PIN);  // RX, TX
@@ -74,6 +86,94 @@ static bool g_selfcalibration_on_off = ON;
   #define debugSerial Serial
 #endif
 
+// The log queue. A message goes into it whole and serial_monitor_poll() sends it from there. When it doesn't fit
+// the oldest messages are sent right away, waiting for the serial port, to make room for it. Only between
+// serial_monitor_pause() calls, around the symbols and the calibration gates, is a message that doesn't fit
+// dropped instead. A LOG_PRIO_LOW message must leave LOG_RESERVE_LOW bytes of the queue free, a LOG_PRIO_NORMAL
+// one LOG_RESERVE_NORMAL and a LOG_PRIO_RECORD one LOG_RESERVE_RECORD: the traces can't crowd out the info log,
+// neither can crowd out the TX and telemetry records, and nothing can crowd out an error.
+#define LOG_RESERVE_LOW      96
+#define LOG_RESERVE_NORMAL   80
+#define LOG_RESERVE_RECORD   8
+
+static_assert(LOG_QUEUE_SIZE <= 255, "The log queue is indexed with a byte");
+static_assert(LOG_QUEUE_SIZE > LOG_RESERVE_LOW, "The log queue is smaller than its reserve");
+
+enum LogPriority {LOG_PRIO_LOW, LOG_PRIO_NORMAL, LOG_PRIO_RECORD, LOG_PRIO_HIGH};
+
+class LogQueue : public Print {
+  public:
+    size_t write(uint8_t c);
+    using Print::write;
+};
+
+static LogQueue logQueue;
+static uint8_t g_log_queue[LOG_QUEUE_SIZE];
+static uint8_t g_log_head = 0;          // Next byte to send
+static uint8_t g_log_count = 0;         // Bytes of whole messages waiting to be sent
+static uint8_t g_log_pending = 0;       // Bytes of the message being written, behind them
+static uint8_t g_log_limit = 0;         // g_log_count + g_log_pending can't go past it, 0 outside a message
+static bool g_log_overflow = false;     // The message being written didn't fit
+static uint8_t g_log_paused = 0;        // serial_monitor_pause() nesting
+static uint16_t g_log_dropped = 0;      // Messages since the power up
+static uint16_t g_log_unreported = 0;   // Messages since the last drop notice
+static bool g_log_dumping = false;      // A dump asked for from the monitor, every message waits for room
+
+static void log_send();
+
+size_t LogQueue::write(uint8_t c) {
+  uint16_t i;
+
+  if (g_log_overflow) return 1;
+  while ((uint16_t)g_log_count + g_log_pending >= g_log_limit) {
+    // Drop it if we can't wait now, or if it's longer than the queue allows for its priority
+    if ((g_log_paused != 0) || (g_log_count == 0)) {
+      g_log_overflow = true;
+      return 1;
+    }
+    log_send();
+  }
+  i = (uint16_t)g_log_head + g_log_count + g_log_pending;
+  if (i >= LOG_QUEUE_SIZE) i -= LOG_QUEUE_SIZE;
+  g_log_queue[i] = c;
+  g_log_pending++;
+  return 1;
+}
+
+static void log_send() {
+  debugSerial.write(g_log_queue[g_log_head]);
+  if (++g_log_head == LOG_QUEUE_SIZE) g_log_head = 0;
+  g_log_count--;
+}
+
+static void log_begin(uint8_t priority) {
+  if (g_log_dumping) {
+    while (g_log_count != 0) log_send();
+  }
+  g_log_pending = 0;
+  g_log_overflow = false;
+  if (priority == LOG_PRIO_LOW)
+    g_log_limit = LOG_QUEUE_SIZE - LOG_RESERVE_LOW;
+  else if (priority == LOG_PRIO_NORMAL)
+    g_log_limit = LOG_QUEUE_SIZE - LOG_RESERVE_NORMAL;
+  else if (priority == LOG_PRIO_RECORD)
+    g_log_limit = LOG_QUEUE_SIZE - LOG_RESERVE_RECORD;
+  else
+    g_log_limit = LOG_QUEUE_SIZE;
+}
+
+// The message is queued whole, or dropped and counted if any of it didn't fit
+static void log_end() {
+  if (g_log_overflow) {
+    if (g_log_dropped < 0xFFFF) g_log_dropped++;
+    if (g_log_unreported < 0xFFFF) g_log_unreported++;
+  }
+  else
+    g_log_count += g_log_pending;
+  g_log_pending = 0;
+  g_log_limit = 0;
+}
+
 bool is_selfcalibration_on(){
   if (g_selfcalibration_on_off == OFF)
     return false;
@@ -89,30 +189,52 @@ bool is_qrm_avoidance_on(){
 }
 
 void print_date_time() {
-  debugSerial.print(year());
-  debugSerial.print(F("-"));
-  debugSerial.print(month());
-  debugSerial.print(F("-"));
-  debugSerial.print(day());
-  debugSerial.print(F(" "));
-  debugSerial.print(hour());
-  debugSerial.print(F(":"));
-  debugSerial.print(minute());
-  debugSerial.print(F(":"));
-  debugSerial.print(second());
-  debugSerial.print(F(" "));
+  logQueue.print(year());
+  logQueue.print(F("-"));
+  logQueue.print(month());
+  logQueue.print(F("-"));
+  logQueue.print(day());
+  logQueue.print(F(" "));
+  logQueue.print(hour());
+  logQueue.print(F(":"));
+  logQueue.print(minute());
+  logQueue.print(F(":"));
+  logQueue.print(second());
+  logQueue.print(F(" "));
 
 }
 
+// Send one binary log record, see GeminiLogRecord.h
+static void log_record_write(uint8_t priority, uint8_t type, const void *payload, uint8_t length) {
+  const uint8_t *p = (const uint8_t *)payload;
+  uint16_t crc = 0xFFFF;
+  uint8_t i;
+
+  crc = _crc16_update(crc, type);
+  crc = _crc16_update(crc, length);
+  for (i = 0; i < length; i++) crc = _crc16_update(crc, p[i]);
+
+  log_begin(priority);
+  logQueue.write(LOG_SYNC_1);
+  logQueue.write(LOG_SYNC_2);
+  logQueue.write(type);
+  logQueue.write(length);
+  logQueue.write(p, length);
+  logQueue.write((uint8_t)crc);
+  logQueue.write((uint8_t)(crc >> 8));
+  log_end();
+}
+
+// Ends the caller's message
 bool toggle_on_off(bool flag){
   bool return_flag = ON;
   
   if (flag == ON){
     return_flag = OFF;
-    debugSerial.println(F(" OFF"));
+    logQueue.println(F(" OFF"));
   }
   else{
-    debugSerial.println(F(" ON"));
+    logQueue.println(F(" ON"));
   }
   return return_flag;
 }
@@ -120,11 +242,13 @@ bool toggle_on_off(bool flag){
 // Log a software error. 
 // swerr_num is unique number 1-255 assigned sequentially (should be unique for each call to swerr). 
 void swerr(byte swerr_num, int data){
+  log_begin(LOG_PRIO_HIGH);
   print_date_time();
-  debugSerial.print(F("***SWERR: "));
-  debugSerial.print(swerr_num);
-  debugSerial.print(F(" data dump in hex: "));
-  debugSerial.println(data, HEX);     
+  logQueue.print(F("***SWERR: "));
+  logQueue.print(swerr_num);
+  logQueue.print(F(" data dump in hex: "));
+  logQueue.println(data, HEX);     
+  log_end();
 }
 
 char *StateNames[] =
@@ -146,7 +270,8 @@ char *EventNames[] =
   "WSPR_TX_TIME",
   "WSPR_CW_TIME",
   "TX_DONE",
-  "TIMER_EXPIRED"
+  "TIMER_EXPIRED",
+  "CALIBRATION_FAIL"
 };
 
 char *ActionNames[] =
@@ -160,79 +285,170 @@ char *ActionNames[] =
 
 
 
+static byte g_sm_trace_state = 0;   // State before the event, for the post trace
+
 void gemini_sm_trace_pre(byte state, byte event){
-  
-  if (g_debug_on_off == OFF) return;
-  
-  print_date_time();
-  debugSerial.print(F(">> gemini PRE sm trace: "));
-  debugSerial.print(F("curr_state: "));
-  debugSerial.print(StateNames[state]);
-  debugSerial.print(F(" curr_event: "));
-  debugSerial.println(EventNames[event]);
+  // A single trace line after the event, with the state it found
+  g_sm_trace_state = state;
+  (void)event;
 }
 
 void gemini_sm_trace_post(byte state, byte processed_event,  byte resulting_action){
+  struct LogState record;
   
   if (g_debug_on_off == OFF) return;
+
+  if (g_binary_log_on_off == ON) {
+    record.time = now();
+    record.state = state;
+    record.event = processed_event;
+    record.action = resulting_action;
+    log_record_write(LOG_PRIO_LOW, LOG_REC_STATE, &record, sizeof(record));
+    return;
+  }
   
+  log_begin(LOG_PRIO_LOW);
   print_date_time();
-  debugSerial.print(F("<< gemini POST sm trace: "));
-  debugSerial.print(F("curr_state: "));
-  debugSerial.print(StateNames[state]);
-  debugSerial.print(F(" event_just_processed: "));
-  debugSerial.print(EventNames[processed_event]);
-  debugSerial.print(F(" action: "));
-  debugSerial.println(ActionNames[resulting_action]);
+  logQueue.print(F("sm "));
+  logQueue.print(StateNames[g_sm_trace_state]);
+  logQueue.print(F(" + "));
+  logQueue.print(EventNames[processed_event]);
+  logQueue.print(F(" -> "));
+  logQueue.print(StateNames[state]);
+  logQueue.print(F(" action:"));
+  logQueue.println(ActionNames[resulting_action]);
+  log_end();
 }
 
 void gemini_log_wspr_tx(char call[], char grid[], unsigned long freq_hz, uint8_t pwr_dbm){
+  struct LogWsprTx record;
 
   // If either txlog is turned on or info logs are turned on then log the TX
   if ((g_txlog_on_off == OFF) && (g_info_log_on_off == OFF)) return; 
+
+  if (g_binary_log_on_off == ON) {
+    // The call and grid are padded with NULs, not terminated
+    memset(&record, 0, sizeof(record));
+    record.time = now();
+    record.freq_hz = freq_hz;
+    record.pwr_dbm = pwr_dbm;
+    memcpy(record.call, call, min(strlen(call), sizeof(record.call)));
+    memcpy(record.grid, grid, min(strlen(grid), sizeof(record.grid)));
+    log_record_write(LOG_PRIO_RECORD, LOG_REC_WSPR_TX, &record, sizeof(record));
+    return;
+  }
   
+  log_begin(LOG_PRIO_RECORD);
   print_date_time();
-  debugSerial.print(F("TX:"));
-  debugSerial.print(freq_hz);
-  debugSerial.print(F(" Call:"));
-  debugSerial.print(call);
-  debugSerial.print(F(" Locator:"));
-  debugSerial.print(grid);
-  debugSerial.print(F(" dbm:"));
-  debugSerial.println(pwr_dbm);  
+  logQueue.print(F("TX:"));
+  logQueue.print(freq_hz);
+  logQueue.print(F(" Call:"));
+  logQueue.print(call);
+  logQueue.print(F(" Locator:"));
+  logQueue.print(grid);
+  logQueue.print(F(" dbm:"));
+  logQueue.println(pwr_dbm);  
+  log_end();
 }
 
-void gemini_log_telemetry (struct GeminiTxData *data) {
+static const char g_telem_field_names[TELEM_FIELDS][5] PROGMEM = {"pos", "alt", "spd", "sats"};
+
+void gemini_log_telemetry(const struct GeminiTelemetryData *data) {
+  struct LogTelemetry record;
+  uint8_t i;
+  uint32_t age_s;
   
   // If either txlog is turned on or info logs are turned on then log the TX
   if ((g_txlog_on_off == OFF) && (g_info_log_on_off == OFF)) return; 
+
+  if (g_binary_log_on_off == ON) {
+    record.time = data->time;
+    record.sequence = data->sequence;
+    record.valid = data->valid;
+    record.latitude_e7 = data->latitude_e7;
+    record.longitude_e7 = data->longitude_e7;
+    record.altitude_cm = data->altitude_cm;
+    record.speed_mkn = data->speed_mkn;
+    record.number_of_sats = data->number_of_sats;
+    record.gps_status = data->gps_status;
+    record.temperature_c = data->temperature_c;
+    record.processor_temperature_c = data->processor_temperature_c;
+    record.battery_voltage_v_x10 = data->battery_voltage_v_x10;
+    log_record_write(LOG_PRIO_RECORD, LOG_REC_TELEMETRY, &record, sizeof(record));
+    return;
+  }
   
+  log_begin(LOG_PRIO_RECORD);
   print_date_time();
-  debugSerial.print(F("Telem Grid:"));
-  debugSerial.print( (*data).grid_sq_6char );
-  debugSerial.print(F(", alt_m:"));
-  debugSerial.print( (*data).altitude_m);
-  debugSerial.print(F(", spd_kn:"));
-  debugSerial.print( (*data).speed_kn);
-  debugSerial.print(F(", num_sats:"));
-  debugSerial.print( (*data).number_of_sats);
-  debugSerial.print(F(", gps_stat:"));
-  debugSerial.print( (*data).gps_status);
-  //debugSerial.print(F(", gps_fix: "));
-  //debugSerial.print( (*data).gps_3d_fix_ok_bool);
-  debugSerial.print(F(", batt_v_x10:"));
-  debugSerial.print( (*data).battery_voltage_v_x10);
-  debugSerial.print(F(", ptemp_c:"));
-  debugSerial.print( (*data).processor_temperature_c);
-  debugSerial.print(F(", temp_c:"));
-  debugSerial.println( (*data).temperature_c);
+  logQueue.print(F("Telem #"));
+  logQueue.print(data->sequence);
+  logQueue.print(F(" Grid:"));
+  logQueue.print(data->grid_sq_6char);
+  logQueue.print(F(", alt_m:"));
+  logQueue.print(data->altitude_cm / 100);
+  logQueue.print(F(", spd_kn:"));
+  logQueue.print(data->speed_mkn / 1000);
+  logQueue.print(F(", num_sats:"));
+  logQueue.print(data->number_of_sats);
+  logQueue.print(F(", gps_stat:"));
+  logQueue.print(data->gps_status);
+  logQueue.print(F(", batt_v_x10:"));
+  logQueue.print(data->battery_voltage_v_x10);
+  logQueue.print(F(", ptemp_c:"));
+  logQueue.print(data->processor_temperature_c);
+  logQueue.print(F(", temp_c:"));
+  logQueue.print(data->temperature_c);
+
+  // The fields that are the last valid value rather than from the current fix, and how old they are
+  for (i = 0; i < TELEM_FIELDS; i++) {
+    if (data->valid & TELEM_VALID(i)) continue;
+    logQueue.print(F(", stale_"));
+    logQueue.print((const __FlashStringHelper *)g_telem_field_names[i]);
+    logQueue.print(':');
+    age_s = telemetry_age_s(data, i);
+    if (age_s == TELEM_AGE_UNKNOWN)
+      logQueue.print('?');
+    else
+      logQueue.print(age_s);
+  }
+  logQueue.println();
+  log_end();
 }
 
 void gemini_log(char msg[])
 {
-  if (g_info_log_on_off == OFF) return;
+  if ((g_info_log_on_off == OFF) && !g_log_dumping) return;
+  log_begin(LOG_PRIO_NORMAL);
   print_date_time();
-  debugSerial.println(msg);
+  logQueue.println(msg);
+  log_end();
+}
+
+void gemini_log_calibration(const struct CalibrationResult *result) {
+  struct LogCalibration record;
+
+  if ((g_info_log_on_off == OFF) || (g_binary_log_on_off == OFF)) return;
+
+  record.time = result->time;
+  record.correction = result->correction;
+  record.residual_ppb = result->residual_ppb;
+  record.duration_s = result->duration_s;
+  record.gates = result->gates;
+  record.status = result->status;
+  record.temperature_c = result->temperature_c;
+  log_record_write(LOG_PRIO_NORMAL, LOG_REC_CALIBRATION, &record, sizeof(record));
+}
+
+// Dumps asked for from the monitor, always printed and without the time. A dump can be much longer than the queue,
+// each line waits for room rather than being dropped. Not for use in a symbol or gate.
+void gemini_print(const char msg[])
+{
+  uint16_t length = strlen(msg) + 2;
+
+  while ((g_log_count != 0) && (LOG_QUEUE_SIZE - g_log_count < length)) log_send();
+  log_begin(LOG_PRIO_HIGH);
+  logQueue.println(msg);
+  log_end();
 }
 
 /**********************
@@ -246,4 +462,177 @@ void serial_monitor_begin(){
   while (!debugSerial)
     ;
   debugSerial.flush();
-}
\ No newline at end of file
+}
+
+// Send some of the log queue, call it often. This never waits for the serial port.
+void serial_monitor_poll() {
+  uint8_t n;
+
+  // Once the queue has emptied, say how many messages didn't make it
+  if ((g_log_count == 0) && (g_log_unreported != 0)) {
+    log_begin(LOG_PRIO_HIGH);
+    print_date_time();
+    logQueue.print(F("***LOG DROPPED: "));
+    logQueue.println(g_log_unreported);
+    log_end();
+    g_log_unreported = 0;
+  }
+
+#if defined (DEBUG_USES_SW_SERIAL)
+  // NeoSWSerial bit-bangs each character with the interrupts off, so only a few of them per call and none
+  // while serial_monitor_pause() is on
+  if (g_log_paused != 0) return;
+  n = LOG_SW_SERIAL_CHARS;
+#else
+  // As many as the UART's transmit buffer has room for, its interrupt sends them from there
+  n = debugSerial.availableForWrite();
+#endif
+  while ((n != 0) && (g_log_count != 0)) {
+    log_send();
+    n--;
+  }
+}
+
+// Around the symbols of a transmission and the calibration gates. The calls nest.
+void serial_monitor_pause(bool pause) {
+  if (pause)
+    g_log_paused++;
+  else if (g_log_paused != 0)
+    g_log_paused--;
+}
+
+// Send everything in the queue, waiting for the serial port
+void serial_monitor_flush() {
+  while (g_log_count != 0) log_send();
+}
+
+uint16_t serial_monitor_dropped() {
+  return g_log_dropped;
+}
+
+/*****************************************************************************************************
+  Commands, one character each. Those that only print a line or flip a switch are done at once. A dump
+  waits until the next slot is more than MONITOR_SLOT_LEAD_S away and then waits for the serial port
+  line by line, the commands typed after it wait in the receive buffer. A calibration or a test
+  transmission is left for the main loop, see serial_monitor_requested().
+*****************************************************************************************************/
+static char g_monitor_pending = 0;      // Dump command waiting for time before the next slot
+static uint8_t g_monitor_requests = 0;  // MonitorRequest bits
+
+static void monitor_toggle(const __FlashStringHelper *name, bool *flag) {
+  log_begin(LOG_PRIO_HIGH);
+  logQueue.print(name);
+  *flag = toggle_on_off(*flag);
+  log_end();
+}
+
+static void monitor_reply(const __FlashStringHelper *text) {
+  log_begin(LOG_PRIO_HIGH);
+  logQueue.println(text);
+  log_end();
+}
+
+static void monitor_version() {
+  log_begin(LOG_PRIO_HIGH);
+  logQueue.print(F("Gemini WSPR " GEMINI_FW_VERSION BOARDNAME " Call:" BEACON_CALLSIGN_6CHAR " F_CPU:"));
+  logQueue.println(F_CPU);
+  log_end();
+}
+
+static void monitor_help() {
+  monitor_reply(F("v version      p counters"));
+  monitor_reply(F("d debug log    t tx log       i info log     b binary log"));
+  monitor_reply(F("q qrm avoid    s self cal     c calibrate    x test tx"));
+  monitor_reply(F("k cal results  m cal model    r recorder     h help"));
+}
+
+static void monitor_counters() {
+  char msg[72];
+
+  sprintf(msg, "Up s:%lu pps:%lu log_dropped:%u", millis() / 1000, pps_edge_count(), serial_monitor_dropped());
+  gemini_log(msg);
+  gps_metrics_dump();
+  sprintf(msg, "Cal corr:%ld mcu_ppb:%ld", (long)calibration_correction(), (long)mcu_clock_error_ppb());
+  gemini_log(msg);
+#if defined (DS1820_TEMP_SENSOR_PRESENT)
+  sprintf(msg, "DS18B20 age_s:%lu", ds1820_age_s());
+  gemini_log(msg);
+#endif
+}
+
+static bool monitor_is_dump(char command) {
+  return (command == 'h') || (command == '?') || (command == 'p') || (command == 'k') || (command == 'm') ||
+         (command == 'r');
+}
+
+static void monitor_dump(char command) {
+  g_log_dumping = true;
+  switch (command) {
+    case 'h' :
+    case '?' : monitor_help(); break;
+    case 'p' : monitor_counters(); break;
+    case 'k' : calibration_results_dump(); break;
+    case 'm' : cal_model_dump(); break;
+#if defined (FLIGHT_RECORDER)
+    case 'r' : recorder_dump(); break;
+#else
+    case 'r' : monitor_reply(F("No flight recorder")); break;
+#endif
+  }
+  g_log_dumping = false;
+}
+
+static void monitor_command(char command) {
+  switch (command) {
+    case 'v' : monitor_version(); break;
+    case 'd' : monitor_toggle(F("Debug log"), &g_debug_on_off); break;
+    case 't' : monitor_toggle(F("TX log"), &g_txlog_on_off); break;
+    case 'i' : monitor_toggle(F("Info log"), &g_info_log_on_off); break;
+    case 'b' : monitor_toggle(F("Binary log"), &g_binary_log_on_off); break;
+    case 'q' : monitor_toggle(F("QRM avoidance"), &g_qrm_avoidance_on_off); break;
+    case 's' : monitor_toggle(F("Self calibration"), &g_selfcalibration_on_off); break;
+    case 'c' :
+      g_monitor_requests |= MONITOR_CALIBRATE;
+#if !defined (CALIBRATION_BACKGROUND)
+      monitor_reply(F("Calibration requested")); // With the background service cal_service_request() replies
+#endif
+      break;
+    case 'x' :
+      g_monitor_requests |= MONITOR_TEST_TX;
+      monitor_reply(F("Test TX requested"));
+      break;
+    case ' ' :
+    case '\r' :
+    case '\n' : break;
+    default : monitor_reply(F("? h for help")); break;
+  }
+}
+
+// Call from the main loop. Reads at most MONITOR_CMD_CHARS characters and never waits, but for a dump.
+void serial_monitor_interface(unsigned int seconds_to_slot) {
+  uint8_t n;
+  char command;
+
+  if (g_monitor_pending != 0) {
+    if (seconds_to_slot <= MONITOR_SLOT_LEAD_S) return;
+    monitor_dump(g_monitor_pending);
+    g_monitor_pending = 0;
+    return;
+  }
+
+  for (n = 0; (n < MONITOR_CMD_CHARS) && (debugSerial.available() > 0); n++) {
+    command = (char)debugSerial.read();
+    if (monitor_is_dump(command)) {
+      g_monitor_pending = command;
+      return;
+    }
+    monitor_command(command);
+  }
+}
+
+// True once for each time the request was made from the monitor
+bool serial_monitor_requested(uint8_t request) {
+  if ((g_monitor_requests & request) == 0) return false;
+  g_monitor_requests &= ~request;
+  return true;
+}
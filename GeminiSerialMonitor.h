@@ -22,15 +22,27 @@
 #include <Arduino.h>
 #include "GeminiXConfig.h"
 
+struct CalibrationResult;
+
 // For use in info logging
 enum GeminiWsprMsgType {PRIMARY_WSPR_MSG, ALTITUDE_TELEM_MSG, TEMPERATURE_TELEM_MSG, VOLTAGE_TELEM_MSG};
 
+// Asked for with a monitor command, carried out by the main loop
+enum MonitorRequest {MONITOR_CALIBRATE = 0x01, MONITOR_TEST_TX = 0x02};
+
 void swerr(byte swerr_num, int data);
 void serial_monitor_begin();
-void serial_monitor_interface();
+void serial_monitor_interface(unsigned int seconds_to_slot);  // Call from the main loop, reads the commands
+bool serial_monitor_requested(uint8_t request);               // A MonitorRequest, true once each time it is made
+void serial_monitor_poll();              // Call from the main loop and while waiting, sends some of the log queue
+void serial_monitor_pause(bool pause);   // No software serial output in between, see GeminiSerialMonitor.cpp
+void serial_monitor_flush();
+uint16_t serial_monitor_dropped();       // Messages that didn't fit in the log queue since the power up
 void gemini_log(char msg[]);
-void gemini_log_telemetry(struct GeminiTxData *data);
+void gemini_print(const char msg[]);
+void gemini_log_telemetry(const struct GeminiTelemetryData *data);
 void gemini_log_wspr_tx(char call[], char grid[], unsigned long freq_hz, uint8_t pwr_dbm);
+void gemini_log_calibration(const struct CalibrationResult *result);  // Binary log only, the text is logged as it runs
 void gemini_sm_trace_pre(byte state, byte event);
 void gemini_sm_trace_post(byte state, byte processed_event,  byte resulting_action);
 bool is_qrm_avoidance_on();
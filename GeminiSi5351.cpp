@@ -105,6 +105,12 @@ void si5351bx_set_correction(int32_t corr) {
   si5351_correction = corr; 
 }
 
+// Set the output drive strength for the specified clock number
+void si5351bx_set_drive(uint8_t clknum, uint8_t drive) {
+  si5351bx_drive[clknum] = drive & 0x03;
+  i2cWrite(16 + clknum, 0x0C | si5351bx_drive[clknum]); // use local msynth
+}
+
 // Set the frequency for the specified clock number
 // Note that fout is in hertz x 100 (i.e. hundredths of hertz). 
 // Frequency range must be between 500 Khz and 109 Mhz
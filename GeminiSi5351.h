@@ -43,6 +43,10 @@ void si5351bx_init();
 // This is used for self-calibration
 void si5351bx_set_correction(int32_t corr);
 
+// Set the output drive strength of the specified clock number, 0=2ma 1=4ma 2=6ma 3=8ma.
+// It is also used by every later si5351bx_setfreq() of that clock.
+void si5351bx_set_drive(uint8_t clknum, uint8_t drive);
+
 // Set the frequency for the specified clock number
 // Note that fout is in hertz x 100 (i.e. hundredths of hertz). 
 // Frequency range must be between 500 Khz and 109 Mhz
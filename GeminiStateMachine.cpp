@@ -21,6 +21,7 @@
 #include "GeminiSerialMonitor.h"
 #include "GeminiStateMachine.h"
 #include "GeminiBoardConfig.h"
+#include "GeminiXConfig.h"
 
 
 GeminiState g_current_gemini_state = POWER_UP;
@@ -28,6 +29,9 @@ GeminiState g_previous_gemini_state = POWER_UP;
 GeminiEvent g_current_gemini_event = NO_EVENT;
 GeminiEvent g_previous_gemini_event = NO_EVENT;
 
+static uint8_t g_calibration_failures = 0;  // Failed calibrations in a row
+static uint8_t g_calibration_skips = 0;     // GPS fixes left without a calibration
+
 
 void gemini_sm_no_op () {
   // Placeholder
@@ -72,7 +76,12 @@ GeminiAction gemini_state_machine(GeminiEvent event) {
 
     case  WAIT_GPS_READY : //executing setup()
       if (event == GPS_READY) {
-        if ((SI5351_SELF_CALIBRATION_SUPPORTED == true) && (is_selfcalibration_on())) {
+        if (g_calibration_skips > 0) {
+          // Calibration keeps failing, give the hardware a rest and go with the last correction
+          g_calibration_skips--;
+          gemini_sm_change_state(WAIT_TX);
+        }
+        else if ((SI5351_SELF_CALIBRATION_SUPPORTED == true) && (is_selfcalibration_on())) {
           // Done setup now do intial calibration
           gemini_sm_change_state(CALIBRATE);
           next_action = DO_CALIBRATION;
@@ -98,6 +107,15 @@ GeminiAction gemini_state_machine(GeminiEvent event) {
     case  CALIBRATE :  // calibrating Si5351a clock
       if (event == CALIBRATION_DONE) {
         // Done setup now do intial calibration
+        g_calibration_failures = 0;
+        gemini_sm_change_state(WAIT_TX);
+      }
+      else if (event == CALIBRATION_FAIL) {
+        // The calibration put back the correction it started with, transmit with it anyway
+        if (++g_calibration_failures >= CALIBRATION_MAX_FAILURES) {
+          g_calibration_failures = 0;
+          g_calibration_skips = CALIBRATION_FAIL_SKIPS;
+        }
         gemini_sm_change_state(WAIT_TX);
       }
       else
@@ -21,7 +21,7 @@
 */
 enum GeminiState {POWER_UP, WAIT_GPS_READY, CALIBRATE, WAIT_TX, TX};
                  
-enum GeminiEvent {NO_EVENT, GPS_READY, GPS_FAIL, SETUP_DONE, CALIBRATION_DONE, WSPR_TX_TIME, CW_TX_TIME, TX_DONE, TIMER_EXPIRED};
+enum GeminiEvent {NO_EVENT, GPS_READY, GPS_FAIL, SETUP_DONE, CALIBRATION_DONE, WSPR_TX_TIME, CW_TX_TIME, TX_DONE, TIMER_EXPIRED, CALIBRATION_FAIL};
 
 enum GeminiAction {NO_ACTION, DO_GPS_FIX, DO_CALIBRATION, DO_WSPR_TX, DO_CW_TX}; 
 void gemini_sm_begin();
@@ -20,6 +20,10 @@
 #include <int.h>
 #include "GeminiXConfig.h"
 #include "GeminiBoardConfig.h"
+#include "GeminiTelemetry.h"
+#include "GeminiQuantizer.h"
+#include "GeminiAdc.h"
+#include "GeminiSerialMonitor.h"
 
 #if defined (DS1820_TEMP_SENSOR_PRESENT)
   #include <OneWire.h>
@@ -30,267 +34,214 @@
 OneWire oneWire(ONE_WIRE_BUS);               // Setup a oneWire instance to communicate with any OneWire devices
 DallasTemperature sensors(&oneWire);        // Pass our oneWire reference to Dallas Temperature.
 
-// Read temperature in C from Dallas DS1820 temperature sensor
-int read_DS1820_temperature() {
+#define DS1820_POWER_ON_RAW  (85 * 128)      // Scratchpad value before any conversion, a conversion that didn't happen
 
-  sensors.requestTemperatures();
+static DeviceAddress g_ds1820_address;
+static int g_ds1820_temperature_c = 0;       // Last good reading
+static unsigned long g_ds1820_read_ms = 0;   // When it was taken
+static unsigned long g_ds1820_start_ms = 0;
+static bool g_ds1820_have_reading = false;
+static bool g_ds1820_converting = false;
+static bool g_ds1820_slot_started = false;   // The conversion for the coming slot has been started
 
-  // After we have the temperatures, we use the function ByIndex, and in this case only the temperature from the first sensor
-  // The temperature is in degrees C, returned as a signed int.
-  return ((int)(sensors.getTempCByIndex(0)));
+static void ds1820_start() {
+  sensors.requestTemperaturesByAddress(g_ds1820_address); // Returns at once, see setWaitForConversion()
+  g_ds1820_start_ms = millis();
+  g_ds1820_converting = true;
 }
-#endif // DS1820_TEMP_SENSOR_PRESENT
 
-#if defined (TMP36_TEMP_SENSOR_PRESENT)
-int read_TEMP36_temperature() {
-  return (double)analogRead(TMP36_PIN) / 1024 * 330 - 50;
-}
-#endif
+// Collect the conversion if it has had its time. A failed one keeps the last good reading, which is reported as stale.
+static void ds1820_collect() {
+  int32_t raw;
+  char msg[48];
 
-int read_voltage_v_x10() {
+  if (!g_ds1820_converting) return;
+  if (millis() - g_ds1820_start_ms < (unsigned long)sensors.millisToWaitForConversion(DS1820_RESOLUTION_BITS)) return;
+  g_ds1820_converting = false;
 
-  int AdcCount, i, voltage_v_x10;
-  float Vpower, sum;
+  raw = sensors.getTemp(g_ds1820_address); // 1/128 C
+  if ((raw == DEVICE_DISCONNECTED_RAW) || (raw == DS1820_POWER_ON_RAW)) {
+    sprintf(msg, "DS18B20 failed, stale by %lus", (millis() - g_ds1820_read_ms) / 1000);
+    gemini_log(msg);
+    return;
+  }
+
+  g_ds1820_temperature_c = raw / 128;
+  g_ds1820_read_ms = millis();
+  g_ds1820_have_reading = true;
+}
 
-  sum = 0;
+// Setup, the first conversion is waited for so there is a reading for the first calibration
+void ds1820_begin() {
+  sensors.begin();
+  if (!sensors.getAddress(g_ds1820_address, 0)) gemini_log("DS18B20 not found");
+  sensors.setResolution(g_ds1820_address, DS1820_RESOLUTION_BITS);
+  sensors.setWaitForConversion(false);
 
-  // Read the voltage 10 times so we can calculate an average
-  for (i = 0; i < 10; i++) {
+  ds1820_start();
+  delay(sensors.millisToWaitForConversion(DS1820_RESOLUTION_BITS));
+  ds1820_collect();
+}
+
+// From loop(), starts the conversion DS1820_LEAD_S before the slot and collects it when ready
+void ds1820_poll(unsigned int seconds_to_slot) {
+  ds1820_collect();
 
-    // Arduino 10bit ADC; 3.3v external AREF each count of 1 = 0.00322265625V
-    AdcCount = analogRead(Vpwerbus); // read Vpwerbus
-    Vpower = AdcCount * 0.00322 * VpwerDivider;
-    sum = sum + Vpower ;
+  if (seconds_to_slot > DS1820_LEAD_S) {
+    g_ds1820_slot_started = false;
+  }
+  else if (!g_ds1820_slot_started && !g_ds1820_converting) {
+    g_ds1820_slot_started = true;
+    ds1820_start();
   }
+}
 
-  Vpower = sum / 10.0; // Calculate the average of the 10 voltage samples
+// Seconds since the last good reading
+unsigned long ds1820_age_s() {
+  return (millis() - g_ds1820_read_ms) / 1000;
+}
 
-  // Shift the voltage one decimal place to the left and convert to an int
-  voltage_v_x10 = (int) (Vpower * 10); // i.e. This converts 3.3333 volt reading to 33 representing 3.3 v
+// Temperature in C from the last good DS18B20 reading, the internal sensor until there is one
+int read_DS1820_temperature() {
+  ds1820_collect(); // In case loop() hasn't had a chance
+  return g_ds1820_have_reading ? g_ds1820_temperature_c : read_processor_temperature();
+}
+#endif // DS1820_TEMP_SENSOR_PRESENT
 
-  return voltage_v_x10;
+#if defined (TMP36_TEMP_SENSOR_PRESENT)
+// 10 mV per degree C with 500 mV at 0 C, on the 3.3 V reference
+int read_TEMP36_temperature() {
+  return ((int32_t)adc_value(ADC_CH_TMP36) * 330 - 50L * ADC_FULL_SCALE) / ADC_FULL_SCALE;
 }
+#endif
 
-#if !defined (DS1820_TEMP_SENSOR_PRESENT) && !defined (TMP36_TEMP_SENSOR_PRESENT)
-int read_processor_temperature() {
+int read_temperature_c() {
+#if defined (DS1820_TEMP_SENSOR_PRESENT)
+  return read_DS1820_temperature();
+#elif defined (TMP36_TEMP_SENSOR_PRESENT)
+  return read_TEMP36_temperature();
+#else
+  return read_processor_temperature();
+#endif
+}
 
-  unsigned int wADC;
-  double temp_c;
+// Volts x10 for one count, scaled by 65536. Folded at compile time so there is no float at run time.
+// 3.3 V external AREF, each count of a 10 bit reading is 0.00322 V before the divider.
+static const uint32_t g_voltage_v_x10_per_count = (uint32_t)(0.00322 * VpwerDivider * 10 * 65536 * 1024 / ADC_FULL_SCALE + 0.5);
 
-  // The internal temperature has to be used
-  // with the internal reference of 1.1V.
-  // Channel 8 can not be selected with
-  // the analogRead function yet.
+int read_voltage_v_x10() {
+  // i.e. a 3.3333 volt reading gives 33 representing 3.3 v
+  return ((uint32_t)adc_value(ADC_CH_BATTERY) * g_voltage_v_x10_per_count) >> 16;
+}
 
-  // Set the internal reference and mux.
-  ADMUX = (_BV(REFS1) | _BV(REFS0) | _BV(MUX3));
-  ADCSRA |= _BV(ADEN);  // enable the ADC
+// The internal sensor on the 1.1 V reference. The offset of 324.31 counts (10 bit) and the gain of 1.22 counts per
+// degree C could be wrong, it is just an indication.
+int read_processor_temperature() {
+  return ((int32_t)adc_value(ADC_CH_PROCESSOR) * 100 - 32431L * ADC_FULL_SCALE / 1024) / (122L * ADC_FULL_SCALE / 1024);
+}
 
-  delay(20);            // wait for voltages to become stable.
+uint32_t telemetry_age_s(const struct GeminiTelemetryData *telemetry, uint8_t field) {
+  if (telemetry->field_time[field] == 0) return TELEM_AGE_UNKNOWN;
+  return telemetry->time - telemetry->field_time[field];
+}
 
-  ADCSRA |= _BV(ADSC);  // Start the ADC
+// Telemetry quantizers, the breakpoints are the lowest value of each bucket after the first one
 
-  // Detect end-of-conversion
-  while (bit_is_set(ADCSRA, ADSC));
+static constexpr int16_t g_altitude_breakpoints_m[] PROGMEM = {
+  1000, 2000, 3000, 4000, 5000, 6000, 7000, 8000, 9000, 10000, 11000, 12000, 13000, 14000, 15000, 16000, 17000, 18000
+};
+static_assert(quantizer_ascending(g_altitude_breakpoints_m), "altitude breakpoints must be ascending");
 
-  // Reading register "ADCW" takes care of how to read ADCL and ADCH.
-  wADC = ADCW;
+// The valid WSPR power levels, also the power field for each 1000 m of altitude from 0 to 18000 m and above
+static const uint8_t g_wspr_power_dbm[] PROGMEM = {
+  0, 3, 7, 10, 13, 17, 20, 23, 27, 30, 33, 37, 40, 43, 47, 50, 53, 57, 60
+};
+static_assert(sizeof(g_wspr_power_dbm) == sizeof(g_altitude_breakpoints_m) / sizeof(int16_t) + 1,
+              "one altitude code per bucket");
 
-  // The offset of 324.31 could be wrong. It is just an indication.
-  temp_c = (wADC - 324.31) / 1.22;
+static constexpr uint8_t g_sats_breakpoints[] PROGMEM = {4, 8};
+static_assert(quantizer_ascending(g_sats_breakpoints), "sats breakpoints must be ascending");
 
-  // The returned temperature is in degrees Celsius.
-  return (((int)temp_c));
-}
-#endif
+// 3.0 V and below is A, then one letter every 0.2 V up to 5.1 V and above
+static constexpr uint8_t g_battery_breakpoints_v_x10[] PROGMEM = {31, 33, 35, 37, 39, 41, 43, 45, 47, 49, 51};
+static_assert(quantizer_ascending(g_battery_breakpoints_v_x10), "battery breakpoints must be ascending");
+
+// -35 C and below is A, then one letter every 5 C up to 6 C and above
+static constexpr int8_t g_temperature_breakpoints_c[] PROGMEM = {-34, -29, -24, -19, -14, -9, -4, 1, 6};
+static_assert(quantizer_ascending(g_temperature_breakpoints_c), "temperature breakpoints must be ascending");
 
 uint8_t encode_altitude (int altitude_m) {
-  uint8_t ret_value = 0;
- 
-  switch (altitude_m) { 
-    
-    case 0 ... 999 :
-      ret_value = 0;
-      break;
-
-    case 1000 ... 1999 :
-      ret_value = 3;
-      break;
-
-    case 2000 ... 2999 :
-      ret_value = 7;
-      break;
-
-    case 3000 ... 3999 :
-      ret_value = 10;
-      break;
-
-    case 4000 ... 4999 :
-      ret_value = 13;
-      break;
-
-    case 5000 ... 5999 :
-      ret_value = 17;
-      break;
-
-    case 6000 ... 6999 :
-      ret_value = 20;
-      break;
-
-    case 7000 ... 7999 :
-      ret_value = 23;
-      break;
-
-    case 8000 ... 8999 :
-      ret_value = 27;
-      break;
-
-    case 9000 ... 9999 :
-      ret_value = 30;
-      break;
-
-    case 10000 ... 10999 :
-      ret_value = 33;
-      break;
-
-    case 11000 ... 11999 :
-      ret_value = 37;
-      break;
-
-    case 12000 ... 12999 :
-      ret_value = 40;
-      break;
-
-    case 13000 ... 13999 :
-      ret_value = 43;
-      break;
-
-    case 14000 ... 14999 :
-      ret_value = 47;
-      break;
-
-    case 15000 ... 15999 :
-      ret_value = 50;
-      break;
-
-    case 16000 ... 16999 :
-      ret_value = 53;
-      break;
-
-    case 17000 ... 17999 :
-      ret_value = 57;
-      break;
-
-    default : //  >= 18000 metres
-      ret_value = 60;
-      break;
-  }
-  return ret_value;
+  // Negative altitudes have always been reported as the top code. So is anything the int16_t table can't hold,
+  // only possible where int is wider than on the AVR.
+  if ((altitude_m < 0) || (altitude_m > INT16_MAX)) return pgm_read_byte(&g_wspr_power_dbm[sizeof(g_wspr_power_dbm) - 1]);
+
+  return pgm_read_byte(&g_wspr_power_dbm[quantize_P(g_altitude_breakpoints_m, (int16_t)altitude_m)]);
 }
 
 int encode_solar_voltage_sats(uint8_t solar_voltage, uint8_t number_of_sats) {
   // No solar voltage, for now
-  switch (number_of_sats) {
-    case 0 ... 3 :
-      return 0;
-      break;
-    case 4 ... 7 :
-      return 1;
-      break;
-    case 8 ... INT8_MAX :
-      return 2;
-      break;
-  }
+  return quantize_P(g_sats_breakpoints, number_of_sats);
 }
 
 char encode_battery_voltage(uint8_t battery_voltage) {
-  uint8_t encoded_voltage, encoded_altitude_fine;
-
-  switch (battery_voltage) {
-    case 0 ... 30 :
-      encoded_voltage = 0;
-      break;
-    case 31 ... 32 :
-      encoded_voltage = 1;
-      break;
-    case 33 ... 34 :
-      encoded_voltage = 2;
-      break;
-    case 35 ... 36 :
-      encoded_voltage = 3;
-      break;
-    case 37 ... 38 :
-      encoded_voltage = 4;
-      break;
-    case 39 ... 40 :
-      encoded_voltage = 5;
-      break;
-    case 41 ... 42 :
-      encoded_voltage = 6;
-      break;
-    case 43 ... 44 :
-      encoded_voltage = 7;
-      break;
-    case 45 ... 46 :
-      encoded_voltage = 8;
-      break;
-    case 47 ... 48 :
-      encoded_voltage = 9;
-      break;
-    case 49 ... 50 :
-      encoded_voltage = 10;
-      break;
-    case 51 ... INT8_MAX :
-      encoded_voltage = 11;
-      break;
-  }
-  return encoded_voltage + 'A';
+  return quantize_P(g_battery_breakpoints_v_x10, battery_voltage) + 'A';
 }
 
 char encode_temperature (int8_t temperature_c) {
-  char ret_value;
-
-  switch ( temperature_c ){
-  
-    case INT8_MIN ... -35:
-      ret_value = (char)0;
-      break;
-
-    case -34 ... -30:
-      ret_value = (char)1;
-      break;
-
-    case -29 ... -25:
-      ret_value = (char)2;
-      break;
-
-    case -24 ... -20:
-      ret_value = (char)3;
-      break;
-
-    case -19 ... -15:
-      ret_value = (char)4;
-      break;
-
-    case -14 ... -10:
-      ret_value = (char)5;
-      break;
-
-    case -9 ... -5:
-      ret_value = (char)6;
-      break;
-
-    case -4 ... 0:
-      ret_value = (char)7;
-      break;
-
-    case 1 ... 5:
-      ret_value = (char)8;
-      break;
-    
-    default:
-      ret_value = (char)9;
-    break;
-  }
-  return ret_value + 'A';
-}
\ No newline at end of file
+  return quantize_P(g_temperature_breakpoints_c, temperature_c) + 'A';
+}
+
+/*
+   U4B basic telemetry
+
+   Each value is scaled to a whole number within its radix and the values are packed into one number with mixed
+   radix arithmetic, which is then unpacked into the radices of the WSPR fields it travels in.
+*/
+
+static char base36(uint8_t value) {
+  return (value < 10) ? '0' + value : 'A' + value - 10;
+}
+
+void encode_u4b_callsign(char callsign[7], char id1, char id3, const char grid_sq_6char[], int32_t altitude_m) {
+  uint32_t val;
+
+  val = (uint8_t)(grid_sq_6char[4] - 'A') % 24;               // Subsquare longitude, 24
+  val = val * 24 + (uint8_t)(grid_sq_6char[5] - 'A') % 24;    // Subsquare latitude, 24
+  val = val * 1068 + (constrain(altitude_m, 0, 21340) + 10) / 20;  // Altitude in 20 m steps, 0 to 21340 m
+
+  callsign[5] = 'A' + val % 26;
+  val /= 26;
+  callsign[4] = 'A' + val % 26;
+  val /= 26;
+  callsign[3] = 'A' + val % 26;
+  val /= 26;
+  callsign[2] = id3;
+  callsign[1] = base36(val % 36);
+  callsign[0] = id1;
+  callsign[6] = '\0';
+}
+
+// Returns the power field
+uint8_t encode_u4b_grid_power(char grid[5], int temperature_c, uint16_t voltage_mv, uint32_t speed_kn, bool gps_valid) {
+  uint32_t val;
+  uint8_t power;
+
+  val = constrain(temperature_c, -50, 39) + 50;                              // -50 to 39 C, 90
+  val = val * 40 + ((constrain(voltage_mv, 3000, 4950) - 3000 + 25) / 50 + 20) % 40;  // 3.00 to 4.95 V in 0.05 V steps, 40
+  val = val * 42 + (min(speed_kn, 82UL) + 1) / 2;                             // 0 to 82 knots in 2 knot steps, 42
+  val = val * 2 + (gps_valid ? 1 : 0);
+  val = val * 2 + 1;  // Satellites OK in the original scheme, decoders now take it as the basic (not extended) telemetry flag
+
+  power = pgm_read_byte(&g_wspr_power_dbm[val % 19]);
+  val /= 19;
+  grid[3] = '0' + val % 10;
+  val /= 10;
+  grid[2] = '0' + val % 10;
+  val /= 10;
+  grid[1] = 'A' + val % 18;
+  val /= 18;
+  grid[0] = 'A' + val % 18;
+  grid[4] = '\0';
+
+  return power;
+}
@@ -25,16 +25,29 @@ int read_TEMP36_temperature();
 #endif
 
 #if defined (DS1820_TEMP_SENSOR_PRESENT)
-int read_DS1820_temperature();
+void ds1820_begin();
+void ds1820_poll(unsigned int seconds_to_slot);
+unsigned long ds1820_age_s();
+int read_DS1820_temperature();   // Last good reading, doesn't wait for a conversion
 #endif
 
-#if !defined (DS1820_TEMP_SENSOR_PRESENT) && !defined TMP36_TEMP_SENSOR_PRESENT
-int read_processor_temperature();
-#endif
+int read_processor_temperature();   // Internal sensor, also when an external one is present
+
+// Temperature in C from whichever sensor the board has
+int read_temperature_c();
 
 int read_voltage_v_x10 ();
+
+// Seconds the field had been stale at the sample, 0 if the sample's fix had it, or TELEM_AGE_UNKNOWN
+uint32_t telemetry_age_s(const struct GeminiTelemetryData *telemetry, uint8_t field);
+
 uint8_t encode_altitude (int altitude_m);
 char encode_temperature (int8_t temperature_c);
 int encode_solar_voltage_sats(uint8_t solar_voltage, uint8_t number_of_sats);
 char encode_battery_voltage(uint8_t battery_voltage);
+
+// U4B basic telemetry. The callsign carries the 5th and 6th grid characters and the altitude, the grid and power
+// fields carry temperature, voltage, speed and GPS validity. Out of range values are clamped.
+void encode_u4b_callsign(char callsign[7], char id1, char id3, const char grid_sq_6char[], int32_t altitude_m);
+uint8_t encode_u4b_grid_power(char grid[5], int temperature_c, uint16_t voltage_mv, uint32_t speed_kn, bool gps_valid);
 #endif
\ No newline at end of file
@@ -58,6 +58,16 @@
 #include "GeminiCalibration.h"
 #include "GeminiTelemetry.h"
 #include "GeminiCW.h"
+#include "GeminiGpsConfig.h"
+#include "GeminiGpsPower.h"
+#include "GeminiGpsMetrics.h"
+#include "GeminiNmeaTime.h"
+#include "GeminiCalModel.h"
+#include "GeminiPersist.h"
+#include "GeminiPark.h"
+#include "GeminiAdc.h"
+#include "GeminiLocator.h"
+#include "GeminiRecorder.h"
 
 // NOTE THAT ALL #DEFINES THAT ARE INTENDED TO BE USER CONFIGURABLE ARE LOCATED IN GeminiXConfig.h and GeminiBoardConfig.h
 // DON'T TOUCH ANYTHING DEFINED IN THIS FILE WITHOUT SOME VERY CAREFUL CONSIDERATION.
@@ -81,6 +91,11 @@
 #define TONE_SPACING            146                 // ~1.46 Hz
 #define SYMBOL_COUNT            WSPR_SYMBOL_COUNT
 
+#define GPS_FIX_TIMEOUT_MS      1200000UL           // Give up on a GPS fix after 20 minutes
+#define GPS_TIME_SYNC_TIMEOUT_MS 1500               // A time-only resync needs one RMC sentence, sent every second
+#define GPS_SLOT_FIX_LEAD_S     10                  // Refresh the GPS fix for the telemetry this many seconds before a slot
+#define WSPR_TX_S               111                 // A WSPR transmission, 162 symbols of 8192/12000 s, rounded up
+
 // Globals
 JTEncode jtencode;
 
@@ -90,6 +105,9 @@ static gps_fix fix;
 
 //Time related
 LightChrono g_chrono, h_chrono;
+#if defined (PERSIST_STATE)
+LightChrono p_chrono;
+#endif
 
 // If we are using software serial to talk to the GPS then we need to create an instance of NeoSWSerial and
 // provide the RX and TX Pin numbers.
@@ -106,26 +124,35 @@ byte g_last_second = 61;
 
 unsigned long g_beacon_freq_hz = FIXED_BEACON_FREQ_HZ;      // The Beacon Frequency in Hz
 
-// Raw Telemetry data types define in GeminiTelemetry.h
-// This contains the last validated Raw telemetry for use during GPS LOS (i.e. we use the last valid data if current data is missing)
-struct GeminiTelemetryData g_last_valid_telemetry = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-struct GeminiTelemetryData g_gemini_current_telemetry {
-  0, 0, 0, 0, 0, 0, 0, 0, 0
-};
-
-// This differs from GeminiTelemetryData mostly in that the values are reformatted with the correct units (i.e altitude in metres vs cm etc.)
-// It is used to populate the global values below prior to encoding the WSPR message for TX
-struct GeminiTxData g_tx_data  = {'0', 0, 0, 0, 0, 0, 0, 0};
-
-// The following values are used in the encoding and transmission of the WSPR Type 1 messages.
-// They are populated from g_tx_data according to the implemented Telemetry encoding rules.
-char g_beacon_callsign[7] = BEACON_CALLSIGN_6CHAR;
-char g_grid_loc[5] = BEACON_GRID_SQ_4CHAR; // Grid Square defaults to hardcoded value it is over-written with a value derived from GPS Coordinates
+// The telemetry of the next slot, see get_telemetry_data(). Fields the GPS fix is missing hold the last valid value.
+struct GeminiTelemetryData g_telemetry;
+
+// The following values are used in the encoding and transmission of the WSPR messages.
+// They are populated from g_telemetry according to the implemented Telemetry encoding rules.
+// The callsign is the size JTEncode takes, room for a compound callsign in angle brackets for a Type 3 message.
+char g_beacon_callsign[13] = BEACON_CALLSIGN_6CHAR;
+char g_grid_loc[7] = BEACON_GRID_SQ_4CHAR; // Grid Square defaults to hardcoded value it is over-written with a value derived from GPS Coordinates
 uint8_t g_tx_pwr_dbm = BEACON_TX_PWR_DBM;  // This value is overwritten to encode telemetry data.
 uint8_t g_tx_buffer[SYMBOL_COUNT];
 
+// Messages of the slot rotation, see prepare_telemetry()
+#define MSG_REGULAR     0   // Callsign (Type 1, Type 2 if compound), 4 character grid, altitude in the power field
+#define MSG_TELEMETRY   1   // Channel ID telemetry or U4B
+#define MSG_LOCATOR     2   // Type 3, hashed callsign and 6 character grid, altitude in the power field
+
+static constexpr bool is_compound_callsign(const char *call) {
+  return (*call != '\0') && ((*call == '/') || is_compound_callsign(call + 1));
+}
+
+static_assert(sizeof(BEACON_CALLSIGN_6CHAR) <= 11, "BEACON_CALLSIGN_6CHAR is longer than 10 characters");
+#if !defined (WSPR_TYPE3_LOCATOR)
+static_assert(!is_compound_callsign(BEACON_CALLSIGN_6CHAR), "A compound callsign needs WSPR_TYPE3_LOCATOR to send a grid");
+#endif
+
 // Globals used by the Gemini Scheduler
 GeminiAction g_current_action = NO_ACTION;
+bool g_slot_fix_done = false; // The fix for the next slot's telemetry has already been refreshed
+bool g_warm_start = false;    // Started from the state saved in EEPROM, the first calibration can be skipped
 
 // Global variables used in ISRs
 volatile bool g_proceed = false;
@@ -133,8 +160,13 @@ volatile bool g_proceed = false;
 // Timer interrupt vector.  This toggles the variable g_proceed which we use to gate
 // each column of output to ensure accurate timing.  This ISR is called whenever
 // Timer1 hits the WSPR_CTC value used below in setup().
+// With TX_FREQ_MONITOR Timer1 counts the calibration clock instead and this is called on every wrap of the
+// count, only some of which are the end of a symbol.
 ISR(TIMER1_COMPA_vect)
 {
+#if defined (TX_FREQ_MONITOR)
+  if (!tx_monitor_symbol_due()) return;
+#endif
   g_proceed = true;
 }
 
@@ -158,178 +190,145 @@ unsigned long get_tx_frequency() {
 
 // -- Telemetry -------
 
-void calculate_gridsquare_6char(float lat, float lon) {
-  /***************************************************************************************
-    Calculate the 6 Character Maidenhead Gridsquare from the Lat and Long Coordinates
-    We follow the convention that West and South are negative Lat/Long.
-  ***************************************************************************************/
-  // This puts the calculated 6 character Maidenhead Grid square into the field grid_sq_6char[]
-  // of g_tx_data
-
-  // Temporary variables for calculation
-  int o1, o2, o3;
-  int a1, a2, a3;
-  float remainder;
-
-  // longitude
-  remainder = lon + 180.0;
-  o1 = (int)(remainder / 20.0);
-  remainder = remainder - (float)o1 * 20.0;
-  o2 = (int)(remainder / 2.0);
-  remainder = remainder - 2.0 * (float)o2;
-  o3 = (int)(12.0 * remainder);
-
-  // latitude
-  remainder = lat + 90.0;
-  a1 = (int)(remainder / 10.0);
-  remainder = remainder - (float)a1 * 10.0;
-  a2 = (int)(remainder);
-  remainder = remainder - (float)a2;
-  a3 = (int)(24.0 * remainder);
-
-  // Generate the 6 character Grid Square
-  g_tx_data.grid_sq_6char[0] = (char)o1 + 'A';
-  g_tx_data.grid_sq_6char[1] = (char)a1 + 'A';
-  g_tx_data.grid_sq_6char[2] = (char)o2 + '0';
-  g_tx_data.grid_sq_6char[3] = (char)a2 + '0';
-  g_tx_data.grid_sq_6char[4] = (char)o3 + 'A';
-  g_tx_data.grid_sq_6char[5] = (char)a3 + 'A';
-  g_tx_data.grid_sq_6char[6] = (char)0;
-} // calculate_gridsquare_6char
-
-
+// Sample the telemetry into g_telemetry
 void get_telemetry_data() {
+  uint32_t t = now();
 
-  // GPS Location
-  if (fix.valid.location) {
-    // We have a valid location so save the lat/long to current_telemetry
-    g_gemini_current_telemetry.latitude = fix.latitude();
-    g_gemini_current_telemetry.longitude = fix.longitude();
+  g_telemetry.sequence++;
+  g_telemetry.time = t;
+  g_telemetry.valid = 0;
 
-    // Copy the lat/long to last_valid_telemetry so we can use it if our fix is invalid (GPS LOS?) next time.
-    g_last_valid_telemetry.latitude = g_gemini_current_telemetry.latitude;
-    g_last_valid_telemetry.longitude = g_gemini_current_telemetry.longitude;
-  }
-  else {
-    // Our position fix isn't valid so use the position information from the last_valid_telemetry, not ideal but better than nothing
-    g_gemini_current_telemetry.latitude = g_last_valid_telemetry.latitude;
-    g_gemini_current_telemetry.longitude =  g_last_valid_telemetry.longitude;
+  // A field the fix doesn't have keeps its last valid value and time (GPS LOS?), not ideal but better than nothing
+  if (fix.valid.location) {
+    g_telemetry.latitude_e7 = fix.latitudeL();
+    g_telemetry.longitude_e7 = fix.longitudeL();
+    g_telemetry.valid |= TELEM_VALID(TELEM_LOCATION);
+    g_telemetry.field_time[TELEM_LOCATION] = t;
   }
 
-  // GPS Altitude
   if (fix.valid.altitude) {
-    g_gemini_current_telemetry.altitude_cm = fix.altitude_cm();
-    g_last_valid_telemetry.altitude_cm = g_gemini_current_telemetry.altitude_cm;
-  }
-  else {
-    // Our altitude fix isn't valid so use the last valid data
-    g_gemini_current_telemetry.altitude_cm  = g_last_valid_telemetry.altitude_cm;
+    g_telemetry.altitude_cm = fix.altitude_cm();
+    g_telemetry.valid |= TELEM_VALID(TELEM_ALTITUDE);
+    g_telemetry.field_time[TELEM_ALTITUDE] = t;
   }
 
-  // GpS Speed
   if (fix.valid.speed) {
-    g_gemini_current_telemetry.speed_mkn = fix.speed_mkn();
-    g_last_valid_telemetry.speed_mkn = g_gemini_current_telemetry.speed_mkn;
-  }
-  else {
-    // Our speed fix isn't valid so use the last valid data
-    g_gemini_current_telemetry.speed_mkn = g_last_valid_telemetry.speed_mkn;
+    g_telemetry.speed_mkn = fix.speed_mkn();
+    g_telemetry.valid |= TELEM_VALID(TELEM_SPEED);
+    g_telemetry.field_time[TELEM_SPEED] = t;
   }
 
-  // GPS number of sats
   if (fix.valid.satellites) {
-    g_gemini_current_telemetry.number_of_sats = fix.satellites;
-    g_last_valid_telemetry.number_of_sats = g_gemini_current_telemetry.number_of_sats;
-  }
-  else {
-    g_gemini_current_telemetry.number_of_sats = g_last_valid_telemetry.number_of_sats;
+    g_telemetry.number_of_sats = fix.satellites;
+    g_telemetry.valid |= TELEM_VALID(TELEM_SATELLITES);
+    g_telemetry.field_time[TELEM_SATELLITES] = t;
   }
 
-  // Overall GPS status.
-  if (fix.valid.status) {
-    g_gemini_current_telemetry.gps_status = fix.status;
-  }
-  else {
-    // Assume that if we don't have a valid Status fix that the GPS status is not OK
-    g_gemini_current_telemetry.gps_status = 0;
-
-  }
+  // Assume that if we don't have a valid Status fix that the GPS status is not OK
+  g_telemetry.gps_status = fix.valid.status ? fix.status : 0;
 
   // Get the remaining non-GPS derived telemetry values.
   // Since these are not reliant on the GPS we assume that we will always be able to get valid values for these.
-#if defined (DS1820_TEMP_SENSOR_PRESENT)
-  g_gemini_current_telemetry.temperature_c = read_DS1820_temperature();
-#elif defined (TMP36_TEMP_SENSOR_PRESENT)
-  g_gemini_current_telemetry.temperature_c = read_TEMP36_temperature();
-#else
-  g_gemini_current_telemetry.temperature_c = read_processor_temperature();
-#endif
-  g_gemini_current_telemetry.battery_voltage_v_x10 = read_voltage_v_x10();
+  g_telemetry.temperature_c = read_temperature_c();
+  g_telemetry.processor_temperature_c = read_processor_temperature();
+  g_telemetry.battery_voltage_v_x10 = read_voltage_v_x10();
 
+  // West and South are negative
+  maidenhead_locator(g_telemetry.latitude_e7, g_telemetry.longitude_e7, g_telemetry.grid_sq_6char, 6);
 }
 
-// This function populates g_tx_data from the current_telemetry data, calculates the 6 char grid square and does unit conversions for most of the GPS data
+// This function encodes the callsign, grid and power of the slot's message from g_telemetry
 void set_tx_data(uint8_t msg_type) {
   
   byte i;
   // Set the transmit frequency
   g_beacon_freq_hz = get_tx_frequency();
 
-  g_tx_data.altitude_m = g_gemini_current_telemetry.altitude_cm / 100; // convert from cm to metres;
-  g_tx_data.speed_kn = g_gemini_current_telemetry.speed_mkn / 1000;   // covert from thousandths of a knot to knots
-  g_tx_data.number_of_sats = g_gemini_current_telemetry.number_of_sats;
-  g_tx_data.gps_status = g_gemini_current_telemetry.gps_status;
-  //g_tx_data.gps_3d_fix_ok_bool = (bool)g_gemini_current_telemetry.gps_status_ok;
-  g_tx_data.temperature_c = g_gemini_current_telemetry.temperature_c;
-  g_tx_data.processor_temperature_c = g_gemini_current_telemetry.processor_temperature_c;
-  g_tx_data.battery_voltage_v_x10 = g_gemini_current_telemetry.battery_voltage_v_x10;
-
-  // Calculate the 6 character grid square and put it into g_tx_data.grid_sq_6char[]
-  calculate_gridsquare_6char(g_gemini_current_telemetry.latitude, g_gemini_current_telemetry.longitude);
-
-  // Copy the first four characters of the Grid Square to g_grid_loc[] (valid for all messages)
-  for (i = 0; i < 4; i++ ) g_grid_loc[i] = g_tx_data.grid_sq_6char[i];
+  // Copy the first four characters of the Grid Square to g_grid_loc[] (valid for all messages but MSG_LOCATOR)
+  for (i = 0; i < 4; i++ ) g_grid_loc[i] = g_telemetry.grid_sq_6char[i];
   g_grid_loc[i] = (char)0; // g_grid_loc[4]
   
   switch (msg_type) {
-    case 0 :
-     for (i = 0; i < 5; i++ ) {
-       g_beacon_callsign[i] = BEACON_CALLSIGN_6CHAR[i];
-       if (BEACON_CALLSIGN_6CHAR[i] == '\0') break;
-     }
-      g_tx_pwr_dbm = encode_altitude(g_tx_data.altitude_m);
+    case MSG_REGULAR :
+      strcpy(g_beacon_callsign, BEACON_CALLSIGN_6CHAR);
+      g_tx_pwr_dbm = encode_altitude(g_telemetry.altitude_cm / 100);
       break;
     
-    case 1:
+    case MSG_LOCATOR :
+      // JTEncode sends a Type 3 message for a callsign in angle brackets, receivers match its hash to the regular message
+      sprintf(g_beacon_callsign, "<%s>", BEACON_CALLSIGN_6CHAR);
+      strcpy(g_grid_loc, g_telemetry.grid_sq_6char);
+      g_tx_pwr_dbm = encode_altitude(g_telemetry.altitude_cm / 100);
+      break;
+
+    case MSG_TELEMETRY :
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_U4B)
+      // Both the callsign and the grid are encoded, the real grid went out with the regular message
+      encode_u4b_callsign(g_beacon_callsign, BEACON_CHANNEL_ID_1, BEACON_CHANNEL_ID_2, g_telemetry.grid_sq_6char,
+                          g_telemetry.altitude_cm / 100);
+      g_tx_pwr_dbm = encode_u4b_grid_power(g_grid_loc, g_telemetry.temperature_c, g_telemetry.battery_voltage_v_x10 * 100,
+                                           g_telemetry.speed_mkn / 1000, g_telemetry.gps_status >= gps_fix::STATUS_STD);
+#else
       g_beacon_callsign[0] = BEACON_CHANNEL_ID_1;
-      g_beacon_callsign[1] = encode_battery_voltage(g_tx_data.battery_voltage_v_x10);
+      g_beacon_callsign[1] = encode_battery_voltage(g_telemetry.battery_voltage_v_x10);
       g_beacon_callsign[2] = BEACON_CHANNEL_ID_2;
-      g_beacon_callsign[3] = g_tx_data.grid_sq_6char[4];
-      g_beacon_callsign[4] = g_tx_data.grid_sq_6char[5];
-      g_beacon_callsign[5] = encode_temperature(g_tx_data.temperature_c);
+      g_beacon_callsign[3] = g_telemetry.grid_sq_6char[4];
+      g_beacon_callsign[4] = g_telemetry.grid_sq_6char[5];
+      g_beacon_callsign[5] = encode_temperature(g_telemetry.temperature_c);
+      g_beacon_callsign[6] = '\0';
 
-      g_tx_pwr_dbm = encode_solar_voltage_sats(0, g_tx_data.number_of_sats); // TDB: This can be utilized better
+      g_tx_pwr_dbm = encode_solar_voltage_sats(0, g_telemetry.number_of_sats); // TDB: This can be utilized better
+#endif
       break;
 
   }
 
-  gemini_log_telemetry (&g_tx_data);  // Pass a pointer to the g_tx_data structure
+  gemini_log_telemetry(&g_telemetry);
 }
 
-void prepare_telemetry(uint8_t minute) {
+// Returns the message type of the slot
+uint8_t prepare_telemetry(uint8_t minute) {
+  uint8_t msg_type;
+
   get_telemetry_data();
 
+#if (TELEMETRY_FORMAT == TELEMETRY_FORMAT_U4B)
+  // U4B telemetry only in the slot that follows the regular message of the channel
+  if (minute % 10 == (U4B_START_MINUTE + 2) % 10) {
+    msg_type = MSG_TELEMETRY;
+  }
+#if defined (WSPR_TYPE3_LOCATOR)
+  else if (minute % 10 == (U4B_START_MINUTE + 4) % 10) {
+    msg_type = MSG_LOCATOR;
+  }
+#endif
+  else {
+    msg_type = MSG_REGULAR;
+  }
+#else
   if (minute % 8 == 0) {
-    set_tx_data(0);
-  } else {
-    set_tx_data(1);
+    msg_type = MSG_REGULAR;
+  }
+#if defined (WSPR_TYPE3_LOCATOR)
+  else if (minute % 8 == 2) {
+    msg_type = MSG_LOCATOR;
+  }
+#endif
+  else {
+    msg_type = MSG_TELEMETRY;
   }
+#endif
 
+  set_tx_data(msg_type);
+#if defined (FLIGHT_RECORDER)
+  recorder_sample(&g_telemetry, calibration_correction());
+#endif
+  return msg_type;
 } //end prepare_telemetry
 
 void encode_and_tx_cw_msg(uint8_t times) {
   uint8_t i;
-  char str[8];
+  char str[16];
   for (i=0; i<times; i++) {
     send_cw("VVV", 2);
     send_cw("CQ", 1);
@@ -339,18 +338,18 @@ void encode_and_tx_cw_msg(uint8_t times) {
     send_cw(str, 3);
 
     send_cw("QTH", 1);
-    send_cw(g_tx_data.grid_sq_6char, 2);
+    send_cw(g_telemetry.grid_sq_6char, 2);
 
     send_cw("QAH", 1);
-    sprintf(str, "%dM", g_tx_data.altitude_m);
+    sprintf(str, "%ldM", (long)(g_telemetry.altitude_cm / 100));
     send_cw(str, 2);
 
     send_cw("QMX",1);
-    sprintf(str, "%dC", g_tx_data.temperature_c);
+    sprintf(str, "%dC", g_telemetry.temperature_c);
     send_cw(str, 2);
 
     send_cw("BAT",1);
-    sprintf(str, "%hdV", g_tx_data.battery_voltage_v_x10) ;
+    sprintf(str, "%hdV", g_telemetry.battery_voltage_v_x10) ;
     send_cw(str, 2);
 
     send_cw("DE", 1);
@@ -368,8 +367,13 @@ void encode_and_tx_wspr_msg() {
   * ************************************************************************/
   uint8_t i;
 
+#if defined (TX_FREQ_MONITOR)
+  // Timer1 keeps counting the calibration clock and times the symbols from it
+  tx_monitor_begin();
+#else
   // Reset the Timer1 interrupt for WSPR transmission
   wspr_tx_interrupt_setup();
+#endif
 
   // Encode the primary message paramters into the TX Buffer
   jtencode.wspr_encode(g_beacon_callsign, g_grid_loc, g_tx_pwr_dbm, g_tx_buffer);
@@ -377,37 +381,54 @@ void encode_and_tx_wspr_msg() {
   // Reset the tone to 0 and turn on the TX output
   si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL));
 
-  // Turn off the PARK clock
-  si5351bx_enable_clk(SI5351A_PARK_CLK_NUM, SI5351_CLK_OFF);
+  // The PARK clock makes way for the TX clock
+  park_tx_start();
 
   // If we are using the TX LED turn it on
 #if defined(TX_LED_PRESENT)
   digitalWrite(TX_LED_PIN, HIGH);
 #endif
 
+  // No software serial output until the last symbol is out, each character would hold off the symbol timing
+  serial_monitor_pause(true);
+
   // We need to synchronize the 1.46 second Timer/Counter-1 interrupt to the start of WSPR transmission as it is free-running.
   // We reset the counts to zero so we ensure that the first symbol is not truncated (i.e we get a full 1.46 seconds before the interrupt handler sets
   // the g_proceed flag).
+#if defined (TX_FREQ_MONITOR)
+  tx_monitor_sync();
+#else
   noInterrupts();
   TCNT1 = 0; // Clear the count for Timer/Counter-1
   GTCCR |= (1 << PSRSYNC); // Do a reset on the pre-scaler. Note that we are not using Timer 0, it shares a prescaler so it would also be impacted.
   interrupts();
+#endif
   // Now send the rest of the message
   for (i = 0; i < SYMBOL_COUNT; i++)
   {
     si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL) + (g_tx_buffer[i] * TONE_SPACING));
     g_proceed = false;
+    park_tx_symbol(i);
+
+#if defined (TX_FREQ_MONITOR)
+    tx_monitor_poll(g_beacon_freq_hz); // A new correction takes effect with the next symbol
+#endif
 
     // We spin our wheels in TX here, waiting until the Timer1 Interrupt sets the g_proceed flag
     // Then we can go back to the top of the for loop to start sending the next symbol
-    while (!g_proceed);
+    while (!g_proceed) serial_monitor_poll();
   }
 
   // Turn off the WSPR TX clock output, we are done sending the message
   si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF);
+  serial_monitor_pause(false);
+
+#if defined (TX_FREQ_MONITOR)
+  tx_monitor_end(g_beacon_freq_hz);
+#endif
 
   // Re-enable the Park Clock
-  si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL)); // Turn on Park Clock
+  park_on();
 
 
   // If we are using the TX LED turn it off
@@ -418,10 +439,67 @@ void encode_and_tx_wspr_msg() {
   delay(1000); // Delay one second
 } // end of encode_and_tx_wspr_msg()
 
-uint8_t gps_fix() {
-  unsigned long start, partial = h_chrono.elapsed();
+// A carrier on the WSPR frequency for MONITOR_TEST_TX_MS, asked for from the monitor to check the transmitter
+void test_tx() {
+  gemini_log("*** Test TX ***");
+  si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL));
+  park_tx_start();
+#if defined(TX_LED_PRESENT)
+  digitalWrite(TX_LED_PIN, HIGH);
+#endif
+
+  delay(MONITOR_TEST_TX_MS);
+
+  si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF);
+  park_on();
+#if defined (TX_LED_PRESENT)
+  digitalWrite(TX_LED_PIN, LOW);
+#endif
+}
+
+#if defined (PERSIST_STATE)
+void persist_state_save() {
+  struct PersistState state;
+
+  state.cal_factor = calibration_correction();
+  state.mcu_clock_error_ppb = mcu_clock_error_ppb();
+  state.latitude_e7 = g_telemetry.latitude_e7;
+  state.longitude_e7 = g_telemetry.longitude_e7;
+  state.altitude_cm = g_telemetry.altitude_cm;
+  cal_model_get(state.cal_model);
+  persist_save(&state);
+}
+
+// Start from the state saved before the last power cycle. Returns false if there is none.
+bool persist_state_restore() {
+  struct PersistState state;
+
+  if (!persist_load(&state)) return false;
+
+  calibration_restore(state.cal_factor);
+  mcu_clock_restore(state.mcu_clock_error_ppb);
+  cal_model_set(state.cal_model);
+
+  // The telemetry falls back on these until the GPS has a fix
+  g_telemetry.latitude_e7 = state.latitude_e7;
+  g_telemetry.longitude_e7 = state.longitude_e7;
+  g_telemetry.altitude_cm = state.altitude_cm;
+  return true;
+}
+#endif
+
+uint8_t gps_fix(unsigned long timeout_ms) {
+  unsigned long start, partial;
+
+  start = partial = h_chrono.elapsed();
+
+#if defined (GPS_POWER_SAVE_MODE)
+  gps_power_wake(); // Does nothing unless the GPS has been put to sleep
+#endif
+
   // Status,UTC Date/Time,Lat,Lon,Hdg,Spd,Alt,Sats,Rx ok,Rx err,Rx chars,
   while (1) {
+    serial_monitor_poll();
     while (gps.available( gpsPort )) {
       fix = gps.read();
       if (fix.valid.location) {
@@ -431,6 +509,10 @@ uint8_t gps_fix() {
                 fix.dateTime.date,
                 fix.dateTime.month, 
                 fix.dateTime.year);
+          gps_metrics_fix_done(h_chrono.elapsed() - start, true);
+#if defined (GPS_POWER_SAVE_MODE)
+          gps_power_fix_result(true);
+#endif
           return 0;
           break;
       }
@@ -439,20 +521,67 @@ uint8_t gps_fix() {
       trace_all( Serial, gps, fix );
       partial = h_chrono.elapsed();
     }
-    if (h_chrono.elapsed() - start > 1200000) { // no fix in 20 minutes
+    if (h_chrono.elapsed() - start > timeout_ms) { // no fix in time
+      gps_metrics_fix_done(h_chrono.elapsed() - start, false);
       h_chrono.restart();
+#if defined (GPS_POWER_SAVE_MODE)
+      gps_power_fix_result(false);
+#endif
       return 1;
       break;
     }
   }
 }
 
+uint8_t gps_time_sync(unsigned long timeout_ms) {
+  /****************************************************************************************************
+    Resync the system time from the first valid RMC/ZDA sentence without going through a full fix.
+    If the PPS is running the time is set on the next PPS edge, which is the start of the following
+    second, otherwise it is set as soon as the sentence has been received.
+  ****************************************************************************************************/
+  struct NmeaTime t;
+  tmElements_t tm;
+  unsigned long start = millis();
+  unsigned long pps_at_start = pps_edge_count();
+  unsigned long pps;
+
+  // Anything buffered may be several seconds old
+  while (gpsPort.available()) gpsPort.read();
+  nmea_time_reset();
+
+  while (millis() - start < timeout_ms) {
+    if (!gpsPort.available()) continue;
+    if (!nmea_time_feed(gpsPort.read(), &t)) continue;
+
+    tm.Hour = t.hours;
+    tm.Minute = t.minutes;
+    tm.Second = t.seconds;
+    tm.Day = t.day;
+    tm.Month = t.month;
+    tm.Year = CalendarYrToTm(t.year);
+
+    pps = pps_edge_count();
+    if (pps != pps_at_start) {
+      // The sentence describes the second started by the last PPS edge, wait for the next one
+      while ((pps_edge_count() == pps) && (millis() - start < timeout_ms + 1000));
+      if (pps_edge_count() != pps) {
+        setTime(makeTime(tm) + 1);
+        return 0;
+      }
+    }
+    setTime(makeTime(tm));
+    return 0;
+  }
+  return 1;
+}
+
 GeminiAction process_gemini_sm_action (GeminiAction action) {
   /****************************************************************************************************
     This is where all of the work gets triggered by processing Actions returned by the state machine.
     We don't need to worry about state we just do what we are told.
   ****************************************************************************************************/
   GeminiAction returned_action = NO_ACTION;
+  GeminiEvent calibration_event;
   uint8_t result;
 
   switch (action) {
@@ -463,7 +592,8 @@ GeminiAction process_gemini_sm_action (GeminiAction action) {
       break;
 
     case DO_GPS_FIX :
-      result = gps_fix();
+      result = gps_fix(GPS_FIX_TIMEOUT_MS);
+      gps_metrics_dump();
       if (result == 0) {
         returned_action = gemini_state_machine(GPS_READY);
       } else {
@@ -472,18 +602,41 @@ GeminiAction process_gemini_sm_action (GeminiAction action) {
       break;
 
     case DO_CALIBRATION :
-
+      calibration_event = CALIBRATION_DONE;
+#if defined (CALIBRATION_BACKGROUND)
+      // Nothing to wait for, the correction is applied ahead of each slot
+      cal_service_start();
+#else
       // Initialize Interrupts for Initial calibration
       setup_calibration();
 
-      //TODO This should be modified with a boolean return code so we can handle calibration fail.
-      do_calibration(COARSE_CORRECTION_STEP); // Initial calibration with 1 Hz correction step
+      if (g_warm_start) {
+        // Go by the saved correction and model until the next CALIBRATION_INTERVAL
+        calibration_apply_model(read_temperature_c());
+      }
+      else {
+        // Only a check gate if the temperature model already has a correction for the current temperature
+        // The step is only used once we are within the counting noise
+        if (do_model_calibration(FINE_CORRECTION_STEP, read_temperature_c()) != 0) calibration_event = CALIBRATION_FAIL;
+      }
+#endif
+      g_warm_start = false;
 
-      returned_action = gemini_state_machine(CALIBRATION_DONE);
+      returned_action = gemini_state_machine(calibration_event);
       break;
     
     case DO_CW_TX :
       prepare_telemetry(0);
+      park_update(g_telemetry.temperature_c, g_telemetry.battery_voltage_v_x10);
+#if defined (CALIBRATION_BACKGROUND)
+      cal_service_apply(g_telemetry.temperature_c); // CW is timed with delay(), the counting carries on during the transmission
+#else
+      calibration_apply_model(g_telemetry.temperature_c);
+#endif
+      g_slot_fix_done = false;
+#if defined (GPS_POWER_SAVE_MODE)
+      gps_power_sleep(seconds_to_next_slot() - gps_power_wake_lead_s()); // We have what we need from the GPS for this slot
+#endif
       gemini_log_wspr_tx(g_beacon_callsign, g_grid_loc, g_beacon_freq_hz, g_tx_pwr_dbm);
       encode_and_tx_cw_msg(2);
       returned_action = gemini_state_machine(TX_DONE);
@@ -499,15 +652,37 @@ GeminiAction process_gemini_sm_action (GeminiAction action) {
 
       // Encode and transmit the Primary WSPR Message
       prepare_telemetry(minute());
-      // g_tx_pwr_dbm = encode_altitude(g_tx_data.altitude_m);
-      // g_tx_pwr_dbm = encode_voltage(g_tx_data.battery_voltage_v_x10); 
+      park_update(g_telemetry.temperature_c, g_telemetry.battery_voltage_v_x10);
+#if defined (CALIBRATION_BACKGROUND)
+      cal_service_apply(g_telemetry.temperature_c);
+#else
+      calibration_apply_model(g_telemetry.temperature_c);
+#endif
+      g_slot_fix_done = false;
+#if defined (GPS_POWER_SAVE_MODE)
+      // We have what we need from the GPS for this slot. Only if the wake-up for the next one comes after the
+      // transmission though, waking the GPS would hold off the symbols.
+      if (seconds_to_next_slot() > gps_power_wake_lead_s() + WSPR_TX_S)
+        gps_power_sleep(seconds_to_next_slot() - gps_power_wake_lead_s());
+#endif
+      // g_tx_pwr_dbm = encode_altitude(g_telemetry.altitude_cm / 100);
+      // g_tx_pwr_dbm = encode_voltage(g_telemetry.battery_voltage_v_x10); 
 // #if defined (DS1820_TEMP_SENSOR_PRESENT) | defined (TMP36_TEMP_SENSOR_PRESENT )
-//       g_tx_pwr_dbm = encode_temperature(g_tx_data.temperature_c); // Use Sensor data
+//       g_tx_pwr_dbm = encode_temperature(g_telemetry.temperature_c); // Use Sensor data
 // #else
-//       g_tx_pwr_dbm = encode_temperature(g_tx_data.processor_temperature_c); // Use internal processor temperature
+//       g_tx_pwr_dbm = encode_temperature(g_telemetry.processor_temperature_c); // Use internal processor temperature
 // #endif
       gemini_log_wspr_tx(g_beacon_callsign, g_grid_loc, g_beacon_freq_hz, g_tx_pwr_dbm); // If TX Logging is enabled then ouput a log
+#if defined (CALIBRATION_BACKGROUND)
+      cal_service_suspend(); // Timer1 becomes the symbol timer
+#endif
       encode_and_tx_wspr_msg();
+#if defined (CALIBRATION_BACKGROUND)
+      cal_service_resume();
+#endif
+#if defined (GPS_PPS_ON_ICP1)
+      pps_begin(); // Timer1 was the symbol timer, give it back to the PPS input capture
+#endif
 
       // Tell the Gemini state machine that we are done tranmitting the Primary WSPR message and update the current_action
       returned_action = gemini_state_machine(TX_DONE);
@@ -521,6 +696,11 @@ GeminiAction process_gemini_sm_action (GeminiAction action) {
 } //  process_gemini_sm_action
 
 
+unsigned int seconds_to_next_slot() {
+  // Slots start on every even minute (CW at second 0 of minutes 0 and 30, WSPR at second 1 otherwise)
+  return 120 - ((minute() % 2) * 60 + second());
+}
+
 GeminiAction gemini_scheduler() {
   /*********************************************************************
     This is the scheduler code that determines the Gemini Beacon schedule
@@ -619,6 +799,7 @@ void setup() {
 
   pinMode(CAL_FREQ_IN_PIN, INPUT); // This is the frequency input must be D5 to use Timer1 as a counter
   pinMode(GPS_PPS_PIN, INPUT);
+  pps_begin(); // Count PPS edges from now on, calibration uses the same interrupt for its gates
 
   // Start Hardware serial communications with the GPS
   gpsPort.begin(GPS_SERIAL_BAUD);
@@ -626,34 +807,70 @@ void setup() {
   // Initialize the Si5351
   si5351bx_init();
 
+#if defined (PERSIST_STATE)
+  // Before any clock is set, so they all start with the saved correction
+  g_warm_start = persist_state_restore();
+#endif
+
   // Setup WSPR TX output
   si5351bx_setfreq(SI5351A_WSPRTX_CLK_NUM, (g_beacon_freq_hz * 100ULL));
   si5351bx_enable_clk(SI5351A_WSPRTX_CLK_NUM, SI5351_CLK_OFF); // Disable the TX clock initially
 
   // Set PARK CLK Output - Note that we leave SI5351A_PARK_CLK_NUM running at 108 Mhz to keep the SI5351 temperature more constant
   // This minimizes thermal induced drift during WSPR transmissions. The idea is borrowed from G0UPL's PARK feature on the QRP Labs U3S
-  si5351bx_setfreq(SI5351A_PARK_CLK_NUM, (PARK_FREQ_HZ * 100ULL)); // Turn on Park Clock
+  // With PARK_THERMAL_CONTROL its frequency and drive follow the measured temperature, see GeminiPark.cpp
+  park_on();
 
   // Setup the software serial port for the serial monitor interface
   serial_monitor_begin();
 
+#if defined (PERSIST_STATE)
+  if (g_warm_start) {
+    char msg[48];
+    sprintf(msg, "Warm start corr:%ld mcu_ppb:%ld", (long)calibration_correction(), (long)mcu_clock_error_ppb());
+    gemini_log(msg);
+    cal_model_dump();
+  }
+#endif
+
 #if defined (GPS_BALLOON_MODE_COMMAND)
   gps.send_P( &gpsPort, (const __FlashStringHelper *) GPS_BALLOON_MODE_COMMAND );
   delay( 250 );
 #endif
 
+  // Prune the NMEA output down to the sentences NeoGPS actually parses
+#if defined (GPS_RECEIVER_MTK) || defined (GPS_RECEIVER_UBLOX)
+  gps_config_begin(gpsPort);
+#endif
+
+#if defined (GPS_POWER_SAVE_MODE)
+  gps_power_begin(gpsPort);
+#endif
+
   // Set the intial state for the Gemini Beacon State Machine
   gemini_sm_begin();
 
   // Read unused analog pin (not connected) to generate a random seed for QRM avoidance feature
   randomSeed(analogRead(ANALOG_PIN_FOR_RNG_SEED));
 
+  // From here on the ADC belongs to the background sampler, the first readings are in when this returns
+  adc_begin();
+#if defined (DS1820_TEMP_SENSOR_PRESENT)
+  ds1820_begin();
+#endif
+#if defined (FLIGHT_RECORDER)
+  recorder_begin();
+#endif
+
   // Start the Chronos
   g_chrono.start();
   h_chrono.start();
+#if defined (PERSIST_STATE)
+  p_chrono.start();
+#endif
 
   // Tell the state machine that we are done SETUP
-  char str[8];
+  char str[16];
   sprintf(str, "%s/B", BEACON_CALLSIGN_6CHAR);
   send_cw(str, 2);
 
@@ -663,20 +880,80 @@ void setup() {
 
 
 void loop() {
-  
+  bool calibration_due;
+
+  // Get a fresh fix ahead of the next slot so the telemetry is current, waking the GPS up first if it is asleep
+  if ((timeStatus() == timeSet) && (gemini_sm_get_current_state() == WAIT_TX)) {
+#if defined (DS1820_TEMP_SENSOR_PRESENT)
+    ds1820_poll(seconds_to_next_slot());
+#endif
+#if defined (GPS_POWER_SAVE_MODE)
+    gps_power_poll(seconds_to_next_slot());
+    if (gps_power_fix_pending()) {
+      g_slot_fix_done = true;
+      gps_fix((seconds_to_next_slot() - 1) * 1000UL);
+    }
+#endif
+    if ((!g_slot_fix_done) && (seconds_to_next_slot() <= GPS_SLOT_FIX_LEAD_S) && (seconds_to_next_slot() > 2)) {
+      g_slot_fix_done = true;
+      gps_fix((seconds_to_next_slot() - 1) * 1000UL);
+    }
+  }
+
+  // Periodic clock resync, the time is all we need here
+#if defined (GPS_POWER_SAVE_MODE)
+  if (gps_power_is_awake() && h_chrono.hasPassed(TIME_SET_INTERVAL_MS, true)) {
+#else
   if (h_chrono.hasPassed(TIME_SET_INTERVAL_MS, true)) {
-    gps_fix();
-    // For logging only:
-    get_telemetry_data();
-    set_tx_data(0);
+#endif
+    gps_time_sync(GPS_TIME_SYNC_TIMEOUT_MS);
   }
   
+#if defined (CALIBRATION_BACKGROUND)
+  cal_service_poll();
+#endif
+  mcu_clock_poll();
+  adc_poll();
+#if defined (FLIGHT_RECORDER)
+  recorder_poll();
+#endif
+  serial_monitor_poll();
+  serial_monitor_interface(seconds_to_next_slot());
+
+  // A test transmission asked for from the monitor, only while waiting for a slot and if it is over before it
+  if ((gemini_sm_get_current_state() == WAIT_TX) && (seconds_to_next_slot() > MONITOR_SLOT_LEAD_S) &&
+      serial_monitor_requested(MONITOR_TEST_TX)) {
+    test_tx();
+  }
+
+#if defined (PERSIST_STATE)
+  if (p_chrono.hasPassed(PERSIST_INTERVAL_MS, true)) persist_state_save();
+#endif
+
+#if defined (NMEAGPS_STATS)
+  gps_metrics_tick(gps.statistics.chars, gps.statistics.ok, gps.statistics.errors, pps_edge_count());
+#else
+  gps_metrics_tick(0, 0, 0, pps_edge_count());
+#endif
+
   // This triggers actual work when the state machine returns an GeminiAction
   while (g_current_action != NO_ACTION) {
     g_current_action = process_gemini_sm_action(g_current_action);
   }
   
-  if (g_chrono.hasPassed(CALIBRATION_INTERVAL, true)) { // When the time set interval has passed, restart the Chronometer set system time again from GPS
+  calibration_due = g_chrono.hasPassed(CALIBRATION_INTERVAL, true);
+  if (serial_monitor_requested(MONITOR_CALIBRATE)) {
+#if defined (CALIBRATION_BACKGROUND)
+    // The periodic one would only start the service again, which is already counting
+    cal_service_request(read_temperature_c());
+#else
+    // Asked for from the monitor, it goes the way of the periodic one and starts a new interval
+    g_chrono.restart();
+    calibration_due = true;
+#endif
+  }
+
+  if (calibration_due) { // When the time set interval has passed, restart the Chronometer set system time again from GPS
     g_current_action = gemini_state_machine(TIMER_EXPIRED);
 #if defined (SYNC_LED_PRESENT)
 if (timeStatus() == timeSet)
@@ -38,41 +38,145 @@
 #define PARK_FREQ_HZ              108000000ULL  //  Use this on clk SI5351A_PARK_CLK_NUM to keep the SI5351a warm to avoid thermal drift during WSPR transmissions. Max 109 Mhz.
 #define CW_BEACON_FREQ_HZ         14099000UL    //  CW Beacon Frequency
 
+// Thermal control of the Si5351 with the PARK clock. The PARK power follows the measured temperature, it is off above
+// PARK_SETPOINT_C and one level higher for each PARK_C_PER_LEVEL below, up to PARK_FREQ_HZ at 8 mA.
+// This is open loop, the temperature is the telemetry's (board) temperature and not the Si5351 die's.
+// Leave PARK_THERMAL_CONTROL commented out to always run the PARK clock at PARK_FREQ_HZ and 8 mA between transmissions.
+//#define PARK_THERMAL_CONTROL
+#define PARK_SETPOINT_C             25          //  Board temperature to aim for
+#define PARK_C_PER_LEVEL            5           //  Degrees C below the setpoint for each PARK power level
+#define PARK_MIN_BATTERY_V_X10      0           //  No PARK below this battery voltage (x10), 0 to ignore the battery
+#define PARK_RAMP_SYMBOLS_PER_LEVEL 4           //  PARK steps down one level every this many symbols as TX starts
+
 // Configuration parameters for Primary WSPR Message (i.e. Callsign, 4 character grid square and power out in dBm)
-#define BEACON_CALLSIGN_6CHAR   "MYCALL"        // Your beacon Callsign, maximum of 6 characters
+#define BEACON_CALLSIGN_6CHAR   "MYCALL"        // Your beacon Callsign, maximum of 6 characters, or up to 10 with a prefix or suffix (see below)
 #define BEACON_GRID_SQ_4CHAR    "FN30"        // Your hardcoded 4 character Grid Square - this will be overwritten with GPS derived Grid
 #define BEACON_TX_PWR_DBM          7          // Beacon Power Output in dBm (5mW = 7dBm)
 #define BEACON_CHANNEL_ID_1     'Q'
 #define BEACON_CHANNEL_ID_2     '9'  
 
+// Encoding of the telemetry message. With U4B the channel IDs above are the U4B channel's first and third callsign
+// characters, the regular message goes out at U4B_START_MINUTE past each 10 minutes and the telemetry 2 minutes later.
+// Avoid a start minute of 0 or 8, minutes 0 and 30 are taken by the CW beacon.
+#define TELEMETRY_FORMAT_GEMINI   1            // Battery, subsquare and temperature in the callsign, satellites in the power field
+#define TELEMETRY_FORMAT_U4B      2            // U4B/Traquito basic telemetry: subsquare, altitude, temperature, voltage, speed, GPS valid
+#define TELEMETRY_FORMAT          TELEMETRY_FORMAT_GEMINI
+#define U4B_START_MINUTE          2
+
+// Send the 6 character grid under our own callsign with a WSPR Type 3 message (hashed callsign), in the slot after the
+// regular message (Gemini format) or after the telemetry message (U4B). A compound BEACON_CALLSIGN_6CHAR, with a prefix
+// of up to 3 characters or a suffix of one character or two digits (PJ4/K1ABC, K1ABC/P), makes the regular message a
+// Type 2 message that has no grid, so it needs this for the position. Requires JTEncode 1.3.0 or later.
+//#define WSPR_TYPE3_LOCATOR
+
 // This defines how often we reset the Arduino Clock to the current GPS time 
 #define TIME_SET_INTERVAL_MS   30000           // 30,000 ms   = 30 seconds
 #define CALIBRATION_INTERVAL   1200000         // 1,200,000 ms  = 20 minutes
+#define CALIBRATION_STOP_RESIDUAL_CHZ  150    // Calibration stops once the worst case residual at the TX frequency is below 1.5 Hz
+#define CALIBRATION_MAX_FAILURES  3            // After this many failed calibrations in a row...
+#define CALIBRATION_FAIL_SKIPS    3            // ...skip calibrating for this many GPS fixes and keep the last correction
+
+// Background calibration. The calibration clock is counted against the GPS PPS whenever Timer1 isn't the WSPR
+// symbol timer and the latest correction is applied ahead of each slot, instead of blocking in a calibration phase.
+// Comment out CALIBRATION_BACKGROUND to go back to the blocking calibration after each GPS fix.
+#define CALIBRATION_BACKGROUND
+#define CAL_BG_WINDOW_S           600          // Older counts are progressively discounted beyond this many seconds
+#define CAL_BG_CONFIDENT_S        120          // Seconds of counting for full confidence in the estimate
+#define CAL_BG_MIN_CONFIDENCE     50           // Minimum confidence (%) to apply a correction before a slot
+
+// In-transmission frequency monitoring. Timer1 keeps counting the calibration clock during WSPR transmissions and
+// the symbols are timed from that count. The correction is updated between symbols from the PPS gates so the drift
+// within a transmission stays small, and the drift profile of each transmission is logged.
+// Needs the calibration clock fed back to D5 (SI5351_SELF_CALIBRATION_SUPPORTED).
+//#define TX_FREQ_MONITOR
+#define TX_MONITOR_GATE_S         8            // Seconds between correction updates
+#define TX_MONITOR_MAX_STEP_PPB   50           // Largest correction step between two symbols, 0.7 Hz at 14 MHz
+
+// Battery voltage and temperatures are sampled in the background by the ADC interrupt, a round of all the channels
+// every ADC_SAMPLE_INTERVAL_MS. Each reading is oversampled and decimated, then low pass filtered.
+#define ADC_SAMPLE_INTERVAL_MS    2000
+#define ADC_OVERSAMPLE_BITS       2            // 4^n samples per reading for n more bits, 12 bit readings
+#define ADC_FILTER_SHIFT          2            // Each reading moves the filtered value by 1/4 of the difference
+//#define ADC_IDLE_SLEEP                       // Idle the CPU while a round is under way, less digital noise
+
+// DS18B20 (DS1820_TEMP_SENSOR_PRESENT in the board config). The conversion is started DS1820_LEAD_S before each slot
+// and collected when done, so it runs while the slot fix is taken. Fewer bits convert faster and use less energy.
+#define DS1820_RESOLUTION_BITS    10           // 9 to 12 bits: 94, 188, 375 or 750 ms for 0.5, 0.25, 0.125 or 0.0625 C
+#define DS1820_LEAD_S             12
+
+// Temperature model of the Si5351 correction. Calibrations are stored per temperature bucket and the correction
+// for the current temperature is applied before each slot. A full calibration only runs when the model has no
+// data for the current temperature or a check measurement is further than CAL_MODEL_TOLERANCE_PPB from it.
+#define CAL_MODEL_MIN_C           -60          // Lowest temperature of the table
+#define CAL_MODEL_BUCKET_C        5            // Width of a bucket in degrees C
+#define CAL_MODEL_BUCKETS         22           // -60 C to +50 C
+#define CAL_MODEL_TOLERANCE_PPB   100          // 1.4 Hz at 14 MHz
+
+// Keep the calibration, the temperature model, the measured processor clock error and the last known position
+// in EEPROM so that after a power cycle the beacon can go straight to the first slot once it has the time.
+// Comment out PERSIST_STATE to always start from SI5351A_CLK_FREQ_CORRECTION.
+#define PERSIST_STATE
+#define PERSIST_INTERVAL_MS       600000       // Save at most every 10 minutes, and only if something has changed
+#define PERSIST_EEPROM_BASE       0            // First EEPROM byte used
+#define PERSIST_SLOTS             3            // Records written in turn, for wear levelling
+
+// Flight recorder, a telemetry sample in the top of the EEPROM at the first slot RECORDER_INTERVAL_S after the last.
+// Samples are stored as differences to the previous one. When the recorder is full the oldest block is reused,
+// each block starts with a complete sample. Decode a dump with tools/recorder_decode.
+#define FLIGHT_RECORDER
+#define RECORDER_INTERVAL_S       900          // About 10 samples per block, the last 7 to 10 hours of the flight
+#define RECORDER_BLOCKS           4
+#define RECORDER_BLOCK_SIZE       152          // Bytes, RECORDER_BLOCKS of them end at the top of the EEPROM
+
+// Send the telemetry, TX, calibration and state machine logs as binary records (GeminiLogRecord.h) instead of text
+// lines, a fraction of the time at MONITOR_SERIAL_BAUD. Decode a capture of the monitor with tools/log_decode.
+//#define MONITOR_BINARY_LOG
+
+// The monitor's messages wait in a queue and go out a few characters at a time from the main loop, logging never
+// waits for the serial port. A message that doesn't fit is dropped and counted.
+#define LOG_QUEUE_SIZE            240          // Bytes, at most 255. The longest text line, the telemetry, is about 230.
+#define LOG_SW_SERIAL_CHARS       2            // Per call with DEBUG_USES_SW_SERIAL, interrupts are off for each one
+
+// Monitor commands, 'h' for the list. Dumps and the test transmission only start this far ahead of a slot.
+#define MONITOR_CMD_CHARS         2            // Characters read per pass through loop()
+#define MONITOR_SLOT_LEAD_S       4            // Seconds, the longest dump takes about 1.5 s at 9600 baud
+#define MONITOR_TEST_TX_MS        2000         // Carrier on the WSPR frequency
+
+// GPS power saving. Once the telemetry for a slot has been captured the GPS is put to sleep and it is woken up
+// ahead of the next slot. The wake-up lead time adapts to the measured time-to-fix.
+// Comment out GPS_POWER_SAVE_MODE to keep the GPS powered all the time.
+#define GPS_POWER_MODE_PIN        1            // Switch the GPS VCC off with GPS_POWER_DISABLE_PIN (requires GPS_POWER_DISABLE_SUPPORTED)
+#define GPS_POWER_MODE_RECEIVER   2            // MTK standby (PMTK161) or u-blox backup (RXM-PMREQ), ephemeris is kept for a hot start
+//#define GPS_POWER_SAVE_MODE     GPS_POWER_MODE_RECEIVER
+#define GPS_WAKE_LEAD_INIT_S      20           // Initial wake-up lead time before a slot in seconds
+#define GPS_WAKE_LEAD_MIN_S       5            // Bounds for the adapted wake-up lead time
+#define GPS_WAKE_LEAD_MAX_S       100
 
 // Type Definitions
 
+// Fields of the GPS fix in the telemetry snapshot. When the fix doesn't have one (GPS LOS?) the snapshot keeps
+// its last valid value, its bit in valid is clear and field_time tells how old it is.
+enum TelemetryField {TELEM_LOCATION, TELEM_ALTITUDE, TELEM_SPEED, TELEM_SATELLITES, TELEM_FIELDS};
+#define TELEM_VALID(field)  (1 << (field))
+#define TELEM_AGE_UNKNOWN   0xFFFFFFFFUL   // The field was never valid since the power up, or came from EEPROM
+
+// Snapshot of the telemetry, sampled once before every slot and read in place by the encoders and the log.
+// Values are in the units the sources give them, the encoders do their own conversions.
 struct GeminiTelemetryData {
-  float latitude;
-  float longitude;
+  uint16_t sequence;                  // Incremented by every sample
+  uint32_t time;                      // now() at the sample
+  uint32_t field_time[TELEM_FIELDS];  // now() at the last sample the field was valid, 0 never
+  uint8_t valid;                      // TELEM_VALID() bits of the fields this sample's fix provided
+  int32_t latitude_e7;                // Degrees * 10^7, as NeoGPS latitudeL()
+  int32_t longitude_e7;
   int32_t altitude_cm;
   uint32_t speed_mkn;
-  int temperature_c;
-  int processor_temperature_c;
-  uint8_t battery_voltage_v_x10;
   uint8_t number_of_sats;
-  uint8_t gps_status; 
-};
-
-struct GeminiTxData {
-  char grid_sq_6char[7]; // 6 Character Grid Square calculated from GPS Lat/Long values.
-  int32_t altitude_m; 
-  uint32_t speed_kn; 
+  uint8_t gps_status;                 // 0 when the fix has no status
   int temperature_c;
   int processor_temperature_c;
-  uint8_t number_of_sats;
-  uint8_t gps_status;
   uint8_t battery_voltage_v_x10;
- // bool gps_3d_fix_ok_bool;
+  char grid_sq_6char[7];              // 6 Character Grid Square calculated from the position
 };
 
 
@@ -0,0 +1,258 @@
+/*
+   gate_sim.cpp - Host simulation of the calibration counter, accuracy against gate length.
+
+   Simulates Timer1 counting the 3.2 MHz calibration clock between GPS PPS edges with the three ways
+   the firmware has of opening and closing a gate:
+
+     legacy    the PPS ISR resets TCNT1 on the first edge and stops Timer1 on the last one. Both happen
+               after the interrupt latency, at different points in the ISR.
+     timestamp TCNT1 is read first thing in the PPS ISR and the gate is the difference of two readings,
+               the constant part of the latency cancels out, its jitter doesn't.
+     capture   the input capture unit latches TCNT1 on the PPS edge (GPS_PPS_ON_ICP1), no latency.
+
+   The interrupt latency is a constant plus the completion of the current instruction, and now and then
+   the PPS interrupt has to wait for another ISR (NeoSWSerial receiving a character, millis()).
+   For each gate length the RMS and worst case error of the measured frequency are printed in
+   hundredths of Hz at the calibration frequency and in ppb.
+
+   With -c the whole of do_calibration() is simulated instead, pairs of gates doubling from
+   CALIBRATION_GATE_MIN_S with the spread of each pair as its noise floor, for a crystal a few ppm off and
+   a range of stop thresholds. Printed per mode and threshold: how often it passes, how long it takes and
+   the true residual left behind, in ppb and in Hz at the TX frequency.
+
+   Build and run:
+
+     g++ -std=gnu++11 -O2 tools/gate_sim/gate_sim.cpp -o gate_sim
+     ./gate_sim [-n trials] [-j pps_jitter_ns] [-p block_probability] [-B block_max_us] [-s seed]
+     ./gate_sim -c [-T max_s] [-n trials] [-j pps_jitter_ns] [-p block_probability] [-B block_max_us] [-s seed]
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <algorithm>
+#include <random>
+
+#define CAL_FREQ_HZ        3200000.0   // Nominal calibration clock, CPU clock / 2.5
+#define CPU_CLOCK_HZ       8000000.0
+#define ISR_ENTRY_CYCLES   40          // Vector, prologue and the Arduino attachInterrupt dispatch
+#define ISR_STOP_CYCLES    30          // legacy: further cycles from the TCNT1 reset to the Timer1 stop
+#define BEACON_FREQ_HZ     14097010.0  // As in GeminiXConfig.h, the stop threshold is a residual at this frequency
+#define GATE_MAX_S         64          // CALIBRATION_GATE_MAX_S
+
+enum GateMode {GATE_LEGACY, GATE_TIMESTAMP, GATE_CAPTURE, GATE_MODES};
+static const char *g_mode_names[GATE_MODES] = {"legacy", "timestamp", "capture"};
+
+static std::mt19937_64 g_rng;
+static double g_pps_jitter_s = 20e-9;      // GPS PPS jitter, RMS
+static double g_block_probability = 0.05;  // Chance that the PPS ISR waits for another ISR
+static double g_block_max_s = 50e-6;
+
+static double uniform(double lo, double hi) {
+  return std::uniform_real_distribution<double>(lo, hi)(g_rng);
+}
+
+static double gaussian(double sigma) {
+  return std::normal_distribution<double>(0.0, sigma)(g_rng);
+}
+
+// Time from the PPS edge to the first instruction of the PPS ISR
+static double isr_latency() {
+  double latency = (ISR_ENTRY_CYCLES + floor(uniform(0, 4))) / CPU_CLOCK_HZ; // Current instruction takes 1 to 4 cycles
+
+  if (uniform(0, 1) < g_block_probability) latency += uniform(0, g_block_max_s);
+  return latency;
+}
+
+// Number of calibration clock edges counted up to time t
+static double counts_at(double f, double phase, double t) {
+  return floor(f * t + phase);
+}
+
+// One gate of gate_s seconds, returns the measured frequency in Hz
+static double measure(GateMode mode, double f, int gate_s) {
+  double phase = uniform(0, 1);
+  double t_start = uniform(0, 1000) + gaussian(g_pps_jitter_s); // PPS edges
+  double t_end = t_start + gate_s + gaussian(g_pps_jitter_s);
+  double count = 0;
+
+  switch (mode) {
+    case GATE_LEGACY :
+      count = counts_at(f, phase, t_end + isr_latency() + ISR_STOP_CYCLES / CPU_CLOCK_HZ) -
+              counts_at(f, phase, t_start + isr_latency());
+      break;
+
+    case GATE_TIMESTAMP :
+      count = counts_at(f, phase, t_end + isr_latency()) - counts_at(f, phase, t_start + isr_latency());
+      break;
+
+    case GATE_CAPTURE :
+      count = counts_at(f, phase, t_end) - counts_at(f, phase, t_start);
+      break;
+
+    default :
+      break;
+  }
+  return count / gate_s;
+}
+
+// Result of one simulated do_calibration()
+struct Calibration {
+  bool pass;
+  double duration_s;
+  double residual_ppb;  // True error of the calibration clock once done
+};
+
+// Mirrors do_calibration(), integer arithmetic included. The crystal is crystal_ppb off and every correction
+// divides the output by (1 + correction / 1e9), as the Si5351 code does.
+static Calibration calibrate(GateMode mode, double crystal_ppb, int32_t stop_ppb, double max_s) {
+  const int64_t target_chz = (int64_t)(CAL_FREQ_HZ * 100);
+  Calibration result = {true, 0, 0};
+  int gate_min_s = (mode == GATE_CAPTURE) ? 1 : 2;
+  int gate_s = gate_min_s;
+  int32_t correction = 0, first, second, error_chz, noise_chz;
+  double f;
+
+  f = CAL_FREQ_HZ * (1.0 + crystal_ppb * 1e-9);
+  result.duration_s = uniform(0, 1) + 1; // Settling gate
+  for (;;) {
+    while ((gate_s > gate_min_s) && (result.duration_s + 2 * gate_s + 2 > max_s)) gate_s /= 2;
+    if (result.duration_s + 2 * gate_s + 2 > max_s) {
+      result.pass = false;
+      break;
+    }
+    f = CAL_FREQ_HZ * (1.0 + crystal_ppb * 1e-9) / (1.0 + correction * 1e-9);
+    first = (int32_t)((int64_t)floor(measure(mode, f, gate_s) * 100) - target_chz);
+    second = (int32_t)((int64_t)floor(measure(mode, f, gate_s) * 100) - target_chz);
+    result.duration_s += 2 * gate_s + uniform(0, 1) + uniform(0, 1);
+
+    noise_chz = std::max(abs(first - second), (100 + gate_s - 1) / gate_s);
+    error_chz = (first + second) / 2;
+    if (((int64_t)(abs(error_chz) + noise_chz) * 1000000000LL) / target_chz <= stop_ppb) break;
+
+    if (abs(error_chz) <= noise_chz) {
+      if (noise_chz > (100 + gate_s - 1) / gate_s) continue; // The pair disagrees, one of them was held off
+      if ((gate_s < GATE_MAX_S) && (result.duration_s + 4 * gate_s + 2 <= max_s)) {
+        gate_s *= 2;
+        continue;
+      }
+      if (gate_s < GATE_MAX_S) {
+        result.pass = false; // Out of time, not the resolution of the gate
+        break;
+      }
+      if (error_chz < 0) correction -= 10; // FINE_CORRECTION_STEP
+      else if (error_chz > 0) correction += 10;
+      break;
+    }
+    correction += (int32_t)(((int64_t)error_chz * (1000000000LL + correction)) / target_chz);
+    gate_s = std::min(gate_s * 2, GATE_MAX_S);
+  }
+  if (!result.pass) correction = 0; // The entry correction is put back
+  f = CAL_FREQ_HZ * (1.0 + crystal_ppb * 1e-9) / (1.0 + correction * 1e-9);
+  result.residual_ppb = (f / CAL_FREQ_HZ - 1.0) * 1e9;
+  return result;
+}
+
+// Sweeps the stop threshold, CALIBRATION_STOP_RESIDUAL_CHZ, for the timestamp and capture modes
+static void convergence(unsigned long trials, double max_s) {
+  static const int stops_chz[] = {20, 50, 70, 100, 150};
+  unsigned long n, passes, over;
+  double duration_sum, duration_max, sum_sq, worst;
+  int32_t stop_ppb;
+  unsigned int s;
+  int mode;
+  Calibration c;
+
+  printf("stop_chz  stop_ppb  %-10s  pass%%  mean_s  max_s  rms_ppb  max_ppb  max_hz  over%%\n", "mode");
+  for (s = 0; s < sizeof(stops_chz) / sizeof(stops_chz[0]); s++) {
+    stop_ppb = (int32_t)(stops_chz[s] * 10000000.0 / BEACON_FREQ_HZ);
+    for (mode = GATE_TIMESTAMP; mode < GATE_MODES; mode++) {
+      passes = over = 0;
+      duration_sum = duration_max = sum_sq = worst = 0;
+      for (n = 0; n < trials; n++) {
+        c = calibrate((GateMode)mode, uniform(-5000, 5000), stop_ppb, max_s);
+        duration_sum += c.duration_s;
+        if (c.duration_s > duration_max) duration_max = c.duration_s;
+        if (!c.pass) continue;
+        passes++;
+        sum_sq += c.residual_ppb * c.residual_ppb;
+        if (fabs(c.residual_ppb) > worst) worst = fabs(c.residual_ppb);
+        if (fabs(c.residual_ppb) > stop_ppb) over++; // Passed but further off than the threshold promised
+      }
+      printf("%8d  %8d  %-10s  %5.1f  %6.1f  %5.1f  %7.1f  %7.1f  %6.2f  %5.1f\n", stops_chz[s], stop_ppb,
+             g_mode_names[mode], 100.0 * passes / trials, duration_sum / trials, duration_max,
+             passes ? sqrt(sum_sq / passes) : 0.0, worst, worst * BEACON_FREQ_HZ * 1e-9,
+             passes ? 100.0 * over / passes : 0.0);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  static const int gates[] = {1, 2, 4, 8, 10, 16, 32, 64};
+  unsigned long trials = 2000;
+  unsigned long seed = 1;
+  unsigned long n;
+  double f, error, sum_sq, worst;
+  double max_s = 100;
+  bool calibration = false;
+  int opt, mode;
+  unsigned int g;
+
+  while ((opt = getopt(argc, argv, "cT:n:j:p:B:s:")) != -1) {
+    switch (opt) {
+      case 'c' : calibration = true; break;
+      case 'T' : max_s = atof(optarg); break;
+      case 'n' : trials = strtoul(optarg, NULL, 10); break;
+      case 'j' : g_pps_jitter_s = atof(optarg) * 1e-9; break;
+      case 'p' : g_block_probability = atof(optarg); break;
+      case 'B' : g_block_max_s = atof(optarg) * 1e-6; break;
+      case 's' : seed = strtoul(optarg, NULL, 10); break;
+      default :
+        fprintf(stderr, "usage: gate_sim [-c] [-T max_s] [-n trials] [-j pps_jitter_ns] [-p block_probability] "
+                "[-B block_max_us] [-s seed]\n");
+        return 2;
+    }
+  }
+  if (trials == 0) trials = 1;
+  g_rng.seed(seed);
+
+  if (calibration) {
+    convergence(trials, max_s);
+    return 0;
+  }
+
+  printf("gate_s  %-10s  rms_chz  max_chz  rms_ppb  max_ppb\n", "mode");
+  for (g = 0; g < sizeof(gates) / sizeof(gates[0]); g++) {
+    for (mode = 0; mode < GATE_MODES; mode++) {
+      sum_sq = 0;
+      worst = 0;
+      for (n = 0; n < trials; n++) {
+        f = CAL_FREQ_HZ * (1.0 + uniform(-5e-6, 5e-6)); // A few ppm off, like an uncalibrated crystal
+        error = measure((GateMode)mode, f, gates[g]) - f;
+        sum_sq += error * error;
+        if (fabs(error) > worst) worst = fabs(error);
+      }
+      error = sqrt(sum_sq / trials);
+      printf("%6d  %-10s  %7.1f  %7.1f  %7.1f  %7.1f\n", gates[g], g_mode_names[mode],
+             error * 100, worst * 100, error / CAL_FREQ_HZ * 1e9, worst / CAL_FREQ_HZ * 1e9);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+   locator_test.cpp - Check maidenhead_locator() against an exact reference over a dense sweep.
+
+   The reference works out the index of the 8 character square on each axis directly with 64 bit
+   arithmetic, floor((position + offset) * 2400 / field size), and takes every character from it. The
+   firmware's locator is compared with it at 4, 6 and 8 characters:
+
+     - within 2 * 10^-7 degrees either side of every extended square boundary of each axis, at random
+       positions on the other one
+     - the poles, the antimeridian on both sides and the equator / Greenwich corners, with positions just
+       beyond the edges which must be clamped
+     - 2 000 000 random positions
+
+   It also checks that an odd or out of range number of characters leaves a proper string: rounded down
+   to a whole pair, empty below 4. Each mismatch is printed (the first 20), the exit status is 1 if there
+   is any.
+
+   Build and run, from the top of the repository:
+
+     g++ -std=gnu++11 -O2 -Itools/nmea_replay/host -I. tools/locator_test/locator_test.cpp GeminiLocator.cpp \
+         -o locator_test
+     ./locator_test
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <Arduino.h>        // After <random>, its min() and max() macros break the standard headers
+#include "GeminiLocator.h"
+
+#define DEG_E7           10000000LL
+#define SQUARES_8CHAR    (18 * 10 * 24 * 10)   // 8 character squares on each axis
+
+static std::mt19937_64 g_rng(1);
+static unsigned long g_checked = 0;
+static unsigned long g_mismatches = 0;
+
+static int64_t random_e7(int64_t limit_e7) {
+  return std::uniform_int_distribution<int64_t>(-limit_e7, limit_e7)(g_rng);
+}
+
+// Index of the 8 character square on one axis, field_e7 is 20 degrees of longitude or 10 of latitude
+static int64_t reference_index(int64_t value_e7, int64_t limit_e7, int64_t field_e7) {
+  int64_t index;
+
+  value_e7 = constrain(value_e7, -limit_e7, limit_e7);
+  index = (value_e7 + limit_e7) * 2400 / field_e7;
+  return (index >= SQUARES_8CHAR) ? SQUARES_8CHAR - 1 : index;   // +90 and +180 are in the last square
+}
+
+static void reference_locator(int64_t latitude_e7, int64_t longitude_e7, char locator[9]) {
+  int64_t lon = reference_index(longitude_e7, 180 * DEG_E7, 20 * DEG_E7);
+  int64_t lat = reference_index(latitude_e7, 90 * DEG_E7, 10 * DEG_E7);
+
+  locator[0] = 'A' + lon / 2400;
+  locator[1] = 'A' + lat / 2400;
+  locator[2] = '0' + (lon / 240) % 10;
+  locator[3] = '0' + (lat / 240) % 10;
+  locator[4] = 'A' + (lon / 10) % 24;
+  locator[5] = 'A' + (lat / 10) % 24;
+  locator[6] = '0' + lon % 10;
+  locator[7] = '0' + lat % 10;
+  locator[8] = '\0';
+}
+
+static void check(int64_t latitude_e7, int64_t longitude_e7) {
+  char expected[9], actual[LOCATOR_MAX_CHARS + 1];
+  uint8_t chars;
+
+  reference_locator(latitude_e7, longitude_e7, expected);
+  for (chars = 4; chars <= 8; chars += 2) {
+    g_checked++;
+    memset(actual, '?', sizeof(actual));
+    maidenhead_locator((int32_t)latitude_e7, (int32_t)longitude_e7, actual, chars);
+    if ((strncmp(expected, actual, chars) == 0) && (actual[chars] == '\0')) continue;
+    if (g_mismatches++ < 20)
+      printf("lat_e7:%lld lon_e7:%lld chars:%u expected %.*s got %.*s\n", (long long)latitude_e7,
+             (long long)longitude_e7, chars, chars, expected, (int)sizeof(actual), actual);
+  }
+}
+
+// Whatever chars is, the locator is a string of the even length at or below it, empty below 4
+static void check_chars() {
+  char expected[9], actual[16];
+  uint8_t chars, length;
+
+  reference_locator(414000000, -717000000, expected);
+  for (chars = 0; chars < 12; chars++) {
+    g_checked++;
+    length = min(chars, (uint8_t)LOCATOR_MAX_CHARS) & ~1;
+    if (length < 4) length = 0;
+    memset(actual, '?', sizeof(actual));
+    maidenhead_locator(414000000, -717000000, actual, chars);
+    if ((strncmp(expected, actual, length) == 0) && (actual[length] == '\0')) continue;
+    g_mismatches++;
+    printf("chars:%u expected %.*s got %.*s\n", chars, length, expected, (int)sizeof(actual), actual);
+  }
+}
+
+int main() {
+  static const int64_t latitudes_e7[] = {-90 * DEG_E7 - 1, -90 * DEG_E7, -90 * DEG_E7 + 1, -1, 0, 1,
+                                         90 * DEG_E7 - 1, 90 * DEG_E7, 90 * DEG_E7 + 1};
+  static const int64_t longitudes_e7[] = {-180 * DEG_E7 - 1, -180 * DEG_E7, -180 * DEG_E7 + 1, -1, 0, 1,
+                                          180 * DEG_E7 - 1, 180 * DEG_E7, 180 * DEG_E7 + 1};
+  char locator[LOCATOR_MAX_CHARS + 1];
+  int64_t k, boundary_e7;
+  unsigned int i, j;
+  int offset, n;
+  long r;
+
+  // Around every extended square boundary, 43200 on each axis
+  for (k = 0; k <= SQUARES_8CHAR; k++) {
+    boundary_e7 = -180 * DEG_E7 + k * 20 * DEG_E7 / 2400;
+    for (offset = -2; offset <= 2; offset++)
+      for (n = 0; n < 20; n++) check(random_e7(90 * DEG_E7), boundary_e7 + offset);
+
+    boundary_e7 = -90 * DEG_E7 + k * 10 * DEG_E7 / 2400;
+    for (offset = -2; offset <= 2; offset++)
+      for (n = 0; n < 20; n++) check(boundary_e7 + offset, random_e7(180 * DEG_E7));
+  }
+
+  // Poles, antimeridian and the corners of the equator with Greenwich, a little beyond the edges too
+  for (i = 0; i < sizeof(latitudes_e7) / sizeof(latitudes_e7[0]); i++)
+    for (j = 0; j < sizeof(longitudes_e7) / sizeof(longitudes_e7[0]); j++) check(latitudes_e7[i], longitudes_e7[j]);
+
+  for (r = 0; r < 2000000; r++) check(random_e7(90 * DEG_E7), random_e7(180 * DEG_E7));
+
+  check_chars();
+
+  maidenhead_locator(90 * DEG_E7, 180 * DEG_E7, locator, 8);
+  printf("North pole at +180: %s\n", locator);
+  maidenhead_locator(-90 * DEG_E7, -180 * DEG_E7, locator, 8);
+  printf("South pole at -180: %s\n", locator);
+  printf("%lu locators checked, %lu mismatches\n", g_checked, g_mismatches);
+  return (g_mismatches == 0) ? 0 : 1;
+}
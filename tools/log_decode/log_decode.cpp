@@ -0,0 +1,183 @@
+/*
+   log_decode.cpp - Decode a capture of the serial monitor with binary log records (MONITOR_BINARY_LOG).
+
+   Binary records are printed as text lines, anything between them (the text logs) is passed through.
+   A frame with a bad CRC is counted and skipped. The framing and the records are in GeminiLogRecord.h.
+
+   Build and run:
+
+     g++ -std=gnu++11 -O2 -I. tools/log_decode/log_decode.cpp -o log_decode
+     ./log_decode [-c] [capture.bin]       (standard input without a file)
+
+     -c  CSV of the telemetry records only
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "GeminiLogRecord.h"
+
+#define LOG_FRAME_OVERHEAD  6   // Sync, type, length and CRC
+
+// Same order as the firmware's enums, see GeminiStateMachine.h and GeminiCalibration.h
+static const char *g_state_names[] = {"POWER_UP", "WAIT_GPS_READY", "CALIBRATE", "WAIT_TX", "TX"};
+static const char *g_event_names[] = {"NO_EVENT", "GPS_READY", "GPS_FAIL", "SETUP_DONE", "CALIBRATION_DONE",
+                                      "WSPR_TX_TIME", "WSPR_CW_TIME", "TX_DONE", "TIMER_EXPIRED", "CALIBRATION_FAIL"};
+static const char *g_action_names[] = {"NO_ACTION", "DO_GPS_FIX", "DO_CALIBRATION", "DO_WSPR_TX", "DO_CW_TX"};
+static const char *g_calibration_status_names[] = {"PASS", "MODEL", "DISAGREE", "NO_PPS", "NO_CLOCK", "NO_CONVERGE"};
+
+#define NAME(table, i)  (((unsigned)(i) < sizeof(table) / sizeof(table[0])) ? table[i] : "?")
+
+static bool g_csv = false;
+static unsigned long g_records[LOG_REC_STATE + 1];
+static unsigned long g_crc_errors = 0;
+
+// _crc16_update() of avr-libc
+static uint16_t crc16_update(uint16_t crc, uint8_t a) {
+  int i;
+
+  crc ^= a;
+  for (i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+  return crc;
+}
+
+// Payload size of each record type, 0 for types this decoder doesn't know
+static unsigned record_size(uint8_t type) {
+  switch (type) {
+    case LOG_REC_TELEMETRY : return sizeof(struct LogTelemetry);
+    case LOG_REC_WSPR_TX : return sizeof(struct LogWsprTx);
+    case LOG_REC_CALIBRATION : return sizeof(struct LogCalibration);
+    case LOG_REC_STATE : return sizeof(struct LogState);
+    default : return 0;
+  }
+}
+
+static void print_time(uint32_t t) {
+  char when[24];
+  time_t tt = t;
+
+  strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&tt));
+  printf("%s ", when);
+}
+
+static void print_record(uint8_t type, const uint8_t *payload) {
+  struct LogTelemetry telemetry;
+  struct LogWsprTx tx;
+  struct LogCalibration calibration;
+  struct LogState state;
+
+  switch (type) {
+    case LOG_REC_TELEMETRY :
+      memcpy(&telemetry, payload, sizeof(telemetry));
+      if (g_csv) {
+        printf("%u,%lu,%.7f,%.7f,%.2f,%.3f,%u,%u,%d,%d,%.1f,%u\n", telemetry.sequence, (unsigned long)telemetry.time,
+               telemetry.latitude_e7 / 1e7, telemetry.longitude_e7 / 1e7, telemetry.altitude_cm / 100.0,
+               telemetry.speed_mkn / 1000.0, telemetry.number_of_sats, telemetry.gps_status, telemetry.temperature_c,
+               telemetry.processor_temperature_c, telemetry.battery_voltage_v_x10 / 10.0, telemetry.valid);
+        break;
+      }
+      print_time(telemetry.time);
+      printf("Telem #%u lat:%.7f lon:%.7f alt_m:%.2f spd_kn:%.3f num_sats:%u gps_stat:%u batt_v:%.1f ptemp_c:%d "
+             "temp_c:%d valid:%s%s%s%s\n", telemetry.sequence, telemetry.latitude_e7 / 1e7, telemetry.longitude_e7 / 1e7,
+             telemetry.altitude_cm / 100.0, telemetry.speed_mkn / 1000.0, telemetry.number_of_sats, telemetry.gps_status,
+             telemetry.battery_voltage_v_x10 / 10.0, telemetry.processor_temperature_c, telemetry.temperature_c,
+             (telemetry.valid & 0x01) ? "P" : "-", (telemetry.valid & 0x02) ? "A" : "-",
+             (telemetry.valid & 0x04) ? "S" : "-", (telemetry.valid & 0x08) ? "N" : "-");
+      break;
+
+    case LOG_REC_WSPR_TX :
+      if (g_csv) break;
+      memcpy(&tx, payload, sizeof(tx));
+      print_time(tx.time);
+      printf("TX:%lu Call:%.*s Locator:%.*s dbm:%u\n", (unsigned long)tx.freq_hz, (int)sizeof(tx.call), tx.call,
+             (int)sizeof(tx.grid), tx.grid, tx.pwr_dbm);
+      break;
+
+    case LOG_REC_CALIBRATION :
+      if (g_csv) break;
+      memcpy(&calibration, payload, sizeof(calibration));
+      print_time(calibration.time);
+      printf("Cal %s %dC corr:%ld res_ppb:%ld gates:%u s:%u\n", NAME(g_calibration_status_names, calibration.status),
+             calibration.temperature_c, (long)calibration.correction, (long)calibration.residual_ppb,
+             calibration.gates, calibration.duration_s);
+      break;
+
+    case LOG_REC_STATE :
+      if (g_csv) break;
+      memcpy(&state, payload, sizeof(state));
+      print_time(state.time);
+      printf("sm %s -> %s action:%s\n", NAME(g_event_names, state.event), NAME(g_state_names, state.state),
+             NAME(g_action_names, state.action));
+      break;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  FILE *f = stdin;
+  std::vector<uint8_t> in;
+  uint8_t buffer[4096];
+  size_t n, i, j, length;
+  uint16_t crc;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c")) != -1) {
+    switch (opt) {
+      case 'c' : g_csv = true; break;
+      default :
+        fprintf(stderr, "usage: log_decode [-c] [capture.bin]\n");
+        return 2;
+    }
+  }
+  if ((optind < argc) && ((f = fopen(argv[optind], "rb")) == NULL)) {
+    perror(argv[optind]);
+    return 1;
+  }
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) in.insert(in.end(), buffer, buffer + n);
+  if (f != stdin) fclose(f);
+
+  if (g_csv) printf("sequence,time,latitude,longitude,altitude_m,speed_kn,sats,gps_status,temperature_c,"
+                    "processor_temperature_c,battery_v,valid\n");
+
+  for (i = 0; i < in.size(); i++) {
+    length = (i + 3 < in.size()) ? record_size(in[i + 2]) : 0;
+    if ((in[i] != LOG_SYNC_1) || (in[i + 1] != LOG_SYNC_2) || (length == 0) || (in[i + 3] != length) ||
+        (i + LOG_FRAME_OVERHEAD + length > in.size())) {
+      // Text between the records
+      if (!g_csv && (in[i] != '\r')) putchar(in[i]);
+      continue;
+    }
+
+    crc = 0xFFFF;
+    for (j = 0; j < length + 2; j++) crc = crc16_update(crc, in[i + 2 + j]);
+    if (crc == (in[i + 4 + length] | (in[i + 5 + length] << 8))) {
+      print_record(in[i + 2], &in[i + 4]);
+      g_records[in[i + 2]]++;
+    }
+    else
+      g_crc_errors++; // The type and length were right, skip the whole frame
+    i += LOG_FRAME_OVERHEAD + length - 1;
+  }
+
+  fprintf(stderr, "records: telemetry:%lu tx:%lu calibration:%lu state:%lu, crc errors:%lu\n",
+          g_records[LOG_REC_TELEMETRY], g_records[LOG_REC_WSPR_TX], g_records[LOG_REC_CALIBRATION],
+          g_records[LOG_REC_STATE], g_crc_errors);
+  return 0;
+}
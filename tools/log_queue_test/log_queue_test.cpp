@@ -0,0 +1,156 @@
+/*
+   log_queue_test.cpp - Check that the log queue delivers a slot's worth of logging with the default configuration.
+
+   The firmware's own logging functions are called in the order of a WSPR slot: the state machine trace of
+   WSPR_TX_TIME, one serial_monitor_poll(), the telemetry, the background calibration line and the TX
+   record, each at its widest. Outside serial_monitor_pause() nothing may be dropped, so this is repeated for
+   several slots and every line must come out.
+
+   Then the same inside a pause, where nothing is sent: a flood of traces and info lines fills the queue up to
+   what their priority allows and is dropped from there on, but a TX record logged after it must still fit.
+
+   Exits with 1 if any check fails.
+
+   Build and run, from the top of the repository, with NeoGPS (https://github.com/SlashDevin/NeoGPS) checked
+   out in $NEOGPS as for tools/nmea_replay:
+
+     g++ -std=gnu++11 -O2 -Itools/nmea_replay/host -I. -I$NEOGPS/src \
+         tools/log_queue_test/log_queue_test.cpp tools/nmea_replay/host/host.cpp Gemini*.cpp $NEOGPS/src/*.cpp \
+         -o log_queue_test
+     ./log_queue_test
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <string.h>
+#include <TimeLib.h>
+#include "HostSim.h"
+#include "GeminiXConfig.h"
+#include "GeminiSerialMonitor.h"
+#include "GeminiStateMachine.h"
+
+#define TEST_SLOTS  10
+
+// No GPS here, host.cpp wants these for the GPS port
+int host_gps_available() {
+  return 0;
+}
+
+int host_gps_read() {
+  return -1;
+}
+
+int host_gps_peek() {
+  return -1;
+}
+
+static unsigned int g_failures = 0;
+
+static void check(bool ok, const char *what) {
+  if (ok) return;
+  printf("FAIL: %s\n", what);
+  g_failures++;
+}
+
+// How many times text is in the serial output so far
+static unsigned int output_count(const char *text) {
+  static char line[256];
+  unsigned int n = 0;
+
+  fflush(g_host_log);
+  rewind(g_host_log);
+  while (fgets(line, sizeof(line), g_host_log) != NULL)
+    if (strstr(line, text) != NULL) n++;
+  fseek(g_host_log, 0, SEEK_END);
+  return n;
+}
+
+// Every field at its widest and all of them stale for 11 days, the longest telemetry line in a flight
+static void widest_telemetry(struct GeminiTelemetryData *data) {
+  uint8_t i;
+
+  memset(data, 0, sizeof(*data));
+  data->sequence = 65535;
+  data->time = now();
+  for (i = 0; i < TELEM_FIELDS; i++) data->field_time[i] = data->time - 999999;
+  data->valid = 0;
+  data->altitude_cm = -2147483647L;
+  data->speed_mkn = 4294967295UL;
+  data->number_of_sats = 255;
+  data->gps_status = 255;
+  data->temperature_c = -32768;
+  data->processor_temperature_c = -32768;
+  data->battery_voltage_v_x10 = 255;
+  strcpy(data->grid_sq_6char, "RR99XX");
+}
+
+static void slot_burst(const struct GeminiTelemetryData *data) {
+  char cal[] = "Cal bg corr:-2147483648 err_chz:-2147483648 s:65535 conf:100";
+  char call[] = "Q01AAA";
+  char grid[] = "RR99";
+
+  gemini_sm_trace_pre(WAIT_TX, WSPR_TX_TIME);
+  gemini_sm_trace_post(TX, WSPR_TX_TIME, DO_WSPR_TX);
+  serial_monitor_poll();
+  gemini_log_telemetry(data);
+  gemini_log(cal);
+  gemini_log_wspr_tx(call, grid, 4294967295UL, 60);
+}
+
+int main() {
+  struct GeminiTelemetryData data;
+  char info[] = "Cal gates:255 gate_s:65535 ms:4294967295 total_ms:4294967295";
+  char call[] = "Q01AAA";
+  char grid[] = "RR99";
+  uint16_t dropped;
+  unsigned int i;
+
+  g_host_log = tmpfile();
+  setTime(12, 34, 56, 18, 10, 2026);     // A date as wide as they come for a while
+  serial_monitor_begin();
+  widest_telemetry(&data);
+
+  for (i = 0; i < TEST_SLOTS; i++) slot_burst(&data);
+  check(serial_monitor_dropped() == 0, "nothing dropped outside a pause");
+  serial_monitor_flush();
+  check(output_count("sm WAIT_TX + WSPR_TX_TIME -> TX action:DO_WSPR_TX") == TEST_SLOTS, "every trace");
+  check(output_count("Telem #65535") == TEST_SLOTS, "every telemetry line");
+  check(output_count("Cal bg corr:") == TEST_SLOTS, "every calibration line");
+  check(output_count("TX:4294967295 Call:Q01AAA") == TEST_SLOTS, "every TX record");
+  printf("%u slots, %u dropped\n", TEST_SLOTS, serial_monitor_dropped());
+
+  // Inside a pause the low priorities give way, the TX record still fits
+  serial_monitor_pause(true);
+  for (i = 0; i < 10; i++) {
+    gemini_sm_trace_post(TX, WSPR_TX_TIME, DO_WSPR_TX);
+    gemini_log(info);
+  }
+  dropped = serial_monitor_dropped();
+  gemini_log_wspr_tx(call, grid, 14097010UL, 23);
+  check(dropped > 0, "the flood is dropped inside a pause");
+  check(serial_monitor_dropped() == dropped, "the TX record is not dropped inside a pause");
+  serial_monitor_pause(false);
+  serial_monitor_flush();
+  serial_monitor_poll();    // The drop notice
+  serial_monitor_flush();
+  check(output_count("TX:14097010 Call:Q01AAA") == 1, "the TX record after the flood");
+  check(output_count("***LOG DROPPED: ") == 1, "the drop notice");
+  printf("Pause: %u dropped\n", serial_monitor_dropped());
+
+  printf("%u failures\n", g_failures);
+  return (g_failures == 0) ? 0 : 1;
+}
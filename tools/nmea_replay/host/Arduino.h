@@ -0,0 +1,186 @@
+/*
+   Arduino.h - Host (Linux) stand-in for the Arduino core, used by the NMEA replay harness.
+
+   Only what the Gemini firmware and NeoGPS use is provided. Time is simulated: millis() and
+   micros() return the harness' virtual clock, which advances as NMEA characters are delivered
+   and on delay(). AVR registers are plain variables so the hardware code compiles and does nothing.
+*/
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define ARDUINO_HOST_SIM
+#define F_CPU 8000000L   // The 8 MHz ATmega328p of the boards
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// Program memory is ordinary memory on the host
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p) (*(void * const *)(p))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+
+#define HEX 16
+#define DEC 10
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define _BV(b) (1 << (b))
+#define bit_is_set(r, b) ((r) & _BV(b))
+#define bit_is_clear(r, b) (!((r) & _BV(b)))
+#define bitRead(v, b) (((v) >> (b)) & 0x01)
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+
+// Interrupt handlers become ordinary functions that the harness may call
+#define ISR(v) extern "C" void v(void); void v(void)
+
+// AVR registers
+#define HOST_REG8(x)  extern volatile uint8_t x;
+#define HOST_REG16(x) extern volatile uint16_t x;
+HOST_REG8(TCCR1A) HOST_REG8(TCCR1B) HOST_REG8(TCCR1C) HOST_REG8(TIMSK1) HOST_REG8(TIFR1) HOST_REG8(GTCCR)
+HOST_REG8(EIMSK) HOST_REG8(EIFR) HOST_REG8(EICRA) HOST_REG8(PCICR) HOST_REG8(PCIFR)
+HOST_REG8(PCMSK0) HOST_REG8(PCMSK1) HOST_REG8(PCMSK2) HOST_REG8(ADMUX) HOST_REG8(ADCSRB) HOST_REG8(DIDR0)
+HOST_REG8(PINB) HOST_REG8(PINC) HOST_REG8(PIND) HOST_REG8(PORTB) HOST_REG8(PORTC) HOST_REG8(PORTD)
+HOST_REG8(DDRB) HOST_REG8(DDRC) HOST_REG8(DDRD) HOST_REG8(SREG) HOST_REG8(MCUSR) HOST_REG8(SMCR) HOST_REG8(PRR)
+HOST_REG8(TCCR2A) HOST_REG8(TCCR2B) HOST_REG8(TIMSK2) HOST_REG8(OCR2A) HOST_REG8(TCNT2)
+HOST_REG16(TCNT1) HOST_REG16(OCR1A) HOST_REG16(OCR1B) HOST_REG16(ICR1) HOST_REG16(ADCW) HOST_REG16(ADC)
+
+enum {
+  CS10 = 0, CS11 = 1, CS12 = 2, WGM12 = 3, WGM13 = 4, ICES1 = 6, ICNC1 = 7,
+  TOIE1 = 0, OCIE1A = 1, OCIE1B = 2, ICIE1 = 5, TOV1 = 0, OCF1A = 1, OCF1B = 2, ICF1 = 5,
+  PSRSYNC = 0, INT0 = 0, INT1 = 1, ISC00 = 0, ISC01 = 1, ISC10 = 2, ISC11 = 3,
+  PCIE0 = 0, PCIE1 = 1, PCIE2 = 2, PCIF0 = 0, PCIF1 = 1, PCIF2 = 2, PCINT13 = 5,
+  REFS0 = 6, REFS1 = 7, MUX0 = 0, MUX1 = 1, MUX2 = 2, MUX3 = 3,
+  ADEN = 7, ADSC = 6, ADATE = 5, ADIF = 4, ADIE = 3, ADPS2 = 2, ADPS1 = 1, ADPS0 = 0
+};
+
+// ADCSRA never reports a conversion in progress, so busy-waits on ADSC end immediately.
+// Starting the ADC in free running interrupt mode runs the conversions there and then, see host_adc_written().
+void host_adc_written();
+struct HostAdcsr {
+  uint8_t value;
+  operator uint8_t() const { return value & ~_BV(ADSC); }
+  HostAdcsr &operator=(uint8_t v) { value = v; host_adc_written(); return *this; }
+  HostAdcsr &operator|=(uint8_t v) { value |= v; host_adc_written(); return *this; }
+  HostAdcsr &operator&=(uint8_t v) { value &= v; return *this; }
+};
+extern HostAdcsr ADCSRA;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t mode);
+void noInterrupts();
+void interrupts();
+void cli();
+void sei();
+void attachInterrupt(int8_t irq, void (*handler)(void), int mode);
+void detachInterrupt(int8_t irq);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+template<class T, class L, class H> T constrain(T a, L l, H h) { return a < (T)l ? (T)l : (a > (T)h ? (T)h : a); }
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return (str == NULL) ? 0 : write((const uint8_t *)str, strlen(str)); }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(const __FlashStringHelper *s);
+    size_t println(const char *s);
+    size_t println(char c);
+    size_t println(unsigned char n, int base = DEC);
+    size_t println(int n, int base = DEC);
+    size_t println(unsigned int n, int base = DEC);
+    size_t println(long n, int base = DEC);
+    size_t println(unsigned long n, int base = DEC);
+    size_t println(double n, int digits = 2);
+    size_t println();
+
+  private:
+    size_t printNumber(unsigned long n, uint8_t base);
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+// Reads come from the NMEA replay, writes go to the harness log (firmware debug output)
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+    int availableForWrite() { return 63; }
+    operator bool() { return true; }
+};
+extern HardwareSerial Serial;
+
+#include "HostSim.h"
+
+#endif
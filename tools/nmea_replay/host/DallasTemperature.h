@@ -0,0 +1,34 @@
+/*
+   DallasTemperature.h - Host stand-in for the DallasTemperature library. The sensor always
+   reads g_host_temperature_c.
+*/
+#ifndef HOST_DALLASTEMPERATURE_H
+#define HOST_DALLASTEMPERATURE_H
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+#define DEVICE_DISCONNECTED_C   -127
+#define DEVICE_DISCONNECTED_RAW -7040
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature {
+  public:
+    DallasTemperature(OneWire *wire) { (void)wire; }
+    void begin() {}
+    uint8_t getDeviceCount() { return 1; }
+    bool getAddress(uint8_t *address, uint8_t index) { (void)index; memset(address, 0x28, 8); return true; }
+    void setResolution(uint8_t bits) { (void)bits; }
+    void setResolution(const uint8_t *address, uint8_t bits) { (void)address; (void)bits; }
+    void setWaitForConversion(bool wait) { (void)wait; }
+    bool isConversionComplete() { return true; }
+    void requestTemperatures() {}
+    bool requestTemperaturesByAddress(const uint8_t *address) { (void)address; return true; }
+    float getTempCByIndex(uint8_t index) { (void)index; return g_host_temperature_c; }
+    float getTempC(const uint8_t *address) { (void)address; return g_host_temperature_c; }
+    int32_t getTemp(const uint8_t *address) { (void)address; return (int32_t)(g_host_temperature_c * 128); }
+    uint16_t millisToWaitForConversion(uint8_t bits) { return 750 >> (12 - bits); }
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+   HostSim.h - Hooks between the host stand-ins and the NMEA replay harness.
+*/
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Virtual clock in microseconds since the start of the replay
+extern uint64_t g_host_us;
+
+// Advance the virtual clock. With a pacing rate > 0 the wall clock is slept to match,
+// 1.0 being real time, 10.0 ten times faster than real time.
+void host_advance_us(uint64_t us);
+extern double g_host_rate;
+
+// Where the firmware's serial output goes, NULL to drop it
+extern FILE *g_host_log;
+
+// Sensor values seen by the firmware
+extern int g_host_analog;            // analogRead() result for every pin
+extern float g_host_temperature_c;   // DS18B20 temperature
+
+// GPS serial input, implemented by the harness
+int host_gps_available();
+int host_gps_read();
+int host_gps_peek();
+
+#endif
@@ -0,0 +1,27 @@
+/*
+   LightChrono.h - Host stand-in for LightChrono (https://github.com/SofaPirate/Chrono)
+*/
+#ifndef HOST_LIGHTCHRONO_H
+#define HOST_LIGHTCHRONO_H
+
+#include <Arduino.h>
+
+class LightChrono {
+  public:
+    LightChrono() { restart(); }
+    void start() { restart(); }
+    void restart() { _startTime = millis(); }
+    unsigned long elapsed() const { return millis() - _startTime; }
+    bool hasPassed(unsigned long timeout) const { return elapsed() >= timeout; }
+    bool hasPassed(unsigned long timeout, bool restartIfPassed) {
+      if (hasPassed(timeout)) {
+        if (restartIfPassed) restart();
+        return true;
+      }
+      return false;
+    }
+  private:
+    unsigned long _startTime;
+};
+
+#endif
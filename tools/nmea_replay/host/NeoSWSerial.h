@@ -0,0 +1,25 @@
+/*
+   NeoSWSerial.h - Host stand-in for NeoSWSerial (https://github.com/SlashDevin/NeoSWSerial).
+   Reads come from the NMEA replay, anything written to the GPS is dropped.
+*/
+#ifndef HOST_NEOSWSERIAL_H
+#define HOST_NEOSWSERIAL_H
+
+#include <Arduino.h>
+
+class NeoSWSerial : public Stream {
+  public:
+    NeoSWSerial(uint8_t rx_pin, uint8_t tx_pin) { (void)rx_pin; (void)tx_pin; }
+    void begin(uint16_t baud) { (void)baud; }
+    void end() {}
+    void listen() {}
+    void ignore() {}
+    int available() { return host_gps_available(); }
+    int read() { return host_gps_read(); }
+    int peek() { return host_gps_peek(); }
+    size_t write(uint8_t c) { (void)c; return 1; }
+    using Print::write;
+    static void rxISR(uint8_t port_input_register) { (void)port_input_register; }
+};
+
+#endif
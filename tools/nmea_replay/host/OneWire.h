@@ -0,0 +1,14 @@
+/*
+   OneWire.h - Host stand-in for the OneWire library
+*/
+#ifndef HOST_ONEWIRE_H
+#define HOST_ONEWIRE_H
+
+#include <Arduino.h>
+
+class OneWire {
+  public:
+    OneWire(uint8_t pin) { (void)pin; }
+};
+
+#endif
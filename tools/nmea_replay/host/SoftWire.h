@@ -0,0 +1,11 @@
+/*
+   SoftWire.h - Host stand-in for the SoftI2CMaster SoftWire wrapper
+*/
+#ifndef HOST_SOFTWIRE_H
+#define HOST_SOFTWIRE_H
+
+#include "Wire.h"
+
+class SoftWire : public TwoWire {};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+   TimeLib.h - Host stand-in for the Time library (https://github.com/PaulStoffregen/Time),
+   running off the replay's virtual clock.
+*/
+#ifndef HOST_TIMELIB_H
+#define HOST_TIMELIB_H
+
+#include <stdint.h>
+#include <time.h>
+
+enum timeStatus_t {timeNotSet, timeNeedsSync, timeSet};
+
+typedef struct {
+  uint8_t Second;
+  uint8_t Minute;
+  uint8_t Hour;
+  uint8_t Wday;   // Day of week, sunday is day 1
+  uint8_t Day;
+  uint8_t Month;
+  uint8_t Year;   // Offset from 1970
+} tmElements_t;
+
+#define CalendarYrToTm(Y) ((Y) - 1970)
+#define tmYearToCalendar(Y) ((Y) + 1970)
+#define y2kYearToTm(Y) ((Y) + 30)
+#define tmYearToY2k(Y) ((Y) - 30)
+
+int hour();
+int hour(time_t t);
+int minute();
+int minute(time_t t);
+int second();
+int second(time_t t);
+int day();
+int day(time_t t);
+int weekday();
+int month();
+int month(time_t t);
+int year();
+int year(time_t t);
+time_t now();
+void setTime(time_t t);
+void setTime(int hr, int min, int sec, int day, int month, int yr);
+void adjustTime(long adjustment);
+timeStatus_t timeStatus();
+void breakTime(time_t time, tmElements_t &tm);
+time_t makeTime(const tmElements_t &tm);
+
+#endif
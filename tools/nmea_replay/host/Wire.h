@@ -0,0 +1,24 @@
+/*
+   Wire.h - Host stand-in for the Arduino I2C library. There is no Si5351 on the host.
+*/
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire : public Stream {
+  public:
+    void begin() {}
+    void setClock(uint32_t clock) { (void)clock; }
+    void beginTransmission(uint8_t address) { (void)address; }
+    uint8_t endTransmission(bool stop = true) { (void)stop; return 0; }
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) { (void)address; return quantity; }
+    size_t write(uint8_t c) { (void)c; return 1; }
+    using Print::write;
+    int available() { return 1; }
+    int read() { return 0; }
+    int peek() { return 0; }
+};
+extern TwoWire Wire;
+
+#endif
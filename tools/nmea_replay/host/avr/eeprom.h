@@ -0,0 +1,16 @@
+/* avr/eeprom.h - Host stand-in, the EEPROM is an array in memory and starts blank on every run */
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define E2END 2047   // Twice the ATmega328p, the structs kept in EEPROM are padded on the host
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+#define eeprom_is_ready() 1
+#define eeprom_write_byte eeprom_update_byte
+#define eeprom_write_block eeprom_update_block
+#endif
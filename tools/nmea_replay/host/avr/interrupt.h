@@ -0,0 +1,2 @@
+/* avr/interrupt.h - Host stand-in, the ISR macro lives in Arduino.h */
+#include <Arduino.h>
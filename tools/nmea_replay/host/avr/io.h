@@ -0,0 +1,2 @@
+/* avr/io.h - Host stand-in, registers live in Arduino.h */
+#include <Arduino.h>
@@ -0,0 +1,2 @@
+/* avr/pgmspace.h - Host stand-in, program memory helpers live in Arduino.h */
+#include <Arduino.h>
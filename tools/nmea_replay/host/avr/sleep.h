@@ -0,0 +1,11 @@
+/* avr/sleep.h - Host stand-in, sleeping returns at once */
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC  1
+
+static inline void set_sleep_mode(uint8_t mode) { (void)mode; }
+static inline void sleep_mode() {}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+   host.cpp - Implementation of the host stand-ins used by the NMEA replay harness
+*/
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <Wire.h>
+#include <avr/eeprom.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Registers
+#define HOST_DEFINE_REG8(x)  volatile uint8_t x = 0;
+#define HOST_DEFINE_REG16(x) volatile uint16_t x = 0;
+HOST_DEFINE_REG8(TCCR1A) HOST_DEFINE_REG8(TCCR1B) HOST_DEFINE_REG8(TCCR1C) HOST_DEFINE_REG8(TIMSK1) HOST_DEFINE_REG8(TIFR1)
+HOST_DEFINE_REG8(GTCCR) HOST_DEFINE_REG8(EIMSK) HOST_DEFINE_REG8(EIFR) HOST_DEFINE_REG8(EICRA) HOST_DEFINE_REG8(PCICR)
+HOST_DEFINE_REG8(PCIFR) HOST_DEFINE_REG8(PCMSK0) HOST_DEFINE_REG8(PCMSK1) HOST_DEFINE_REG8(PCMSK2) HOST_DEFINE_REG8(ADMUX)
+HOST_DEFINE_REG8(ADCSRB) HOST_DEFINE_REG8(DIDR0) HOST_DEFINE_REG8(PINB) HOST_DEFINE_REG8(PINC) HOST_DEFINE_REG8(PIND)
+HOST_DEFINE_REG8(PORTB) HOST_DEFINE_REG8(PORTC) HOST_DEFINE_REG8(PORTD) HOST_DEFINE_REG8(DDRB) HOST_DEFINE_REG8(DDRC)
+HOST_DEFINE_REG8(DDRD) HOST_DEFINE_REG8(SREG) HOST_DEFINE_REG8(MCUSR) HOST_DEFINE_REG8(SMCR) HOST_DEFINE_REG8(PRR)
+HOST_DEFINE_REG8(TCCR2A) HOST_DEFINE_REG8(TCCR2B) HOST_DEFINE_REG8(TIMSK2) HOST_DEFINE_REG8(OCR2A) HOST_DEFINE_REG8(TCNT2)
+HOST_DEFINE_REG16(TCNT1) HOST_DEFINE_REG16(OCR1A) HOST_DEFINE_REG16(OCR1B) HOST_DEFINE_REG16(ICR1) HOST_DEFINE_REG16(ADCW)
+HOST_DEFINE_REG16(ADC)
+HostAdcsr ADCSRA = {0};
+
+// EEPROM, blank like a new chip
+static uint8_t g_host_eeprom[E2END + 1];
+static bool g_host_eeprom_init = false;
+
+static uint8_t *host_eeprom(const void *addr) {
+  if (!g_host_eeprom_init) {
+    memset(g_host_eeprom, 0xFF, sizeof(g_host_eeprom));
+    g_host_eeprom_init = true;
+  }
+  return &g_host_eeprom[(uintptr_t)addr & E2END];
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) { return *host_eeprom(addr); }
+void eeprom_update_byte(uint8_t *addr, uint8_t value) { *host_eeprom(addr) = value; }
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+  for (size_t i = 0; i < n; i++) ((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+  for (size_t i = 0; i < n; i++) eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+}
+
+// Simulation state
+uint64_t g_host_us = 0;
+double g_host_rate = 0.0;
+FILE *g_host_log = NULL;
+int g_host_analog = 512;
+float g_host_temperature_c = 20.0;
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+void host_advance_us(uint64_t us) {
+  g_host_us += us;
+  if ((g_host_rate > 0.0) && (us > 0)) usleep((useconds_t)(us / g_host_rate));
+}
+
+// ------- Arduino core -------
+
+unsigned long millis() { return (unsigned long)(g_host_us / 1000); }
+unsigned long micros() { return (unsigned long)g_host_us; }
+void delay(unsigned long ms) { host_advance_us((uint64_t)ms * 1000); }
+void delayMicroseconds(unsigned int us) { host_advance_us(us); }
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+void digitalWrite(uint8_t pin, uint8_t val) { (void)pin; (void)val; }
+int digitalRead(uint8_t pin) { (void)pin; return LOW; }
+int analogRead(uint8_t pin) { (void)pin; return g_host_analog; }
+
+// Free running ADC with the interrupt enabled: every conversion reads g_host_analog and calls the
+// firmware's ADC_vect, until the handler switches the ADC off
+extern "C" void ADC_vect(void);
+
+void host_adc_written() {
+  const uint8_t running = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE);
+  static bool in_handler = false;
+
+  if (in_handler) return;
+  in_handler = true;
+  while ((ADCSRA.value & running) == running) {
+    ADC = ADCW = g_host_analog;
+    ADC_vect();
+  }
+  in_handler = false;
+}
+void analogReference(uint8_t mode) { (void)mode; }
+void noInterrupts() {}
+void interrupts() {}
+void cli() {}
+void sei() {}
+void attachInterrupt(int8_t irq, void (*handler)(void), int mode) { (void)irq; (void)handler; (void)mode; }
+void detachInterrupt(int8_t irq) { (void)irq; }
+long random(long howbig) { return (howbig <= 0) ? 0 : rand() % howbig; }
+long random(long howsmall, long howbig) { return (howsmall >= howbig) ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { srand(seed); }
+
+// ------- Print -------
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  *str = '\0';
+  if (base < 2) base = 10;
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::print(const __FlashStringHelper *s) { return write((const char *)s); }
+size_t Print::print(const char *s) { return write(s); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char n, int base) { return print((unsigned long)n, base); }
+size_t Print::print(int n, int base) { return print((long)n, base); }
+size_t Print::print(unsigned int n, int base) { return print((unsigned long)n, base); }
+size_t Print::print(long n, int base) {
+  if ((base == DEC) && (n < 0)) return write('-') + printNumber((unsigned long)(-n), DEC);
+  return printNumber((unsigned long)n, base);
+}
+size_t Print::print(unsigned long n, int base) { return printNumber(n, base); }
+size_t Print::print(double n, int digits) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const __FlashStringHelper *s) { return print(s) + println(); }
+size_t Print::println(const char *s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char n, int base) { return print(n, base) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+
+// ------- Serial -------
+
+int HardwareSerial::available() { return host_gps_available(); }
+int HardwareSerial::read() { return host_gps_read(); }
+int HardwareSerial::peek() { return host_gps_peek(); }
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (g_host_log == NULL) return 1;
+  if (c != '\r') fputc(c, g_host_log);
+  return 1;
+}
+
+// ------- TimeLib -------
+
+static time_t g_sys_time = 0;
+static unsigned long g_prev_millis = 0;
+static timeStatus_t g_time_status = timeNotSet;
+
+time_t now() {
+  while (millis() - g_prev_millis >= 1000) {
+    g_sys_time++;
+    g_prev_millis += 1000;
+  }
+  return g_sys_time;
+}
+
+void setTime(time_t t) {
+  g_sys_time = t;
+  g_prev_millis = millis();
+  g_time_status = timeSet;
+}
+
+void setTime(int hr, int min, int sec, int dy, int mnth, int yr) {
+  tmElements_t tm;
+
+  // Two digit years are from 2000 like in the Time library, four digit years are calendar years
+  if (yr > 99)
+    yr = yr - 1970;
+  else
+    yr += 30;
+  tm.Year = yr;
+  tm.Month = mnth;
+  tm.Day = dy;
+  tm.Hour = hr;
+  tm.Minute = min;
+  tm.Second = sec;
+  setTime(makeTime(tm));
+}
+
+void adjustTime(long adjustment) { g_sys_time += adjustment; }
+timeStatus_t timeStatus() { now(); return g_time_status; }
+
+void breakTime(time_t t, tmElements_t &tm) {
+  struct tm utc;
+
+  gmtime_r(&t, &utc);
+  tm.Second = utc.tm_sec;
+  tm.Minute = utc.tm_min;
+  tm.Hour = utc.tm_hour;
+  tm.Wday = utc.tm_wday + 1;
+  tm.Day = utc.tm_mday;
+  tm.Month = utc.tm_mon + 1;
+  tm.Year = utc.tm_year - 70;
+}
+
+time_t makeTime(const tmElements_t &tm) {
+  struct tm utc;
+
+  memset(&utc, 0, sizeof(utc));
+  utc.tm_sec = tm.Second;
+  utc.tm_min = tm.Minute;
+  utc.tm_hour = tm.Hour;
+  utc.tm_mday = tm.Day;
+  utc.tm_mon = tm.Month - 1;
+  utc.tm_year = tm.Year + 70;
+  return timegm(&utc);
+}
+
+static tmElements_t now_elements(time_t t) {
+  tmElements_t tm;
+  breakTime(t, tm);
+  return tm;
+}
+
+int hour(time_t t) { return now_elements(t).Hour; }
+int hour() { return hour(now()); }
+int minute(time_t t) { return now_elements(t).Minute; }
+int minute() { return minute(now()); }
+int second(time_t t) { return now_elements(t).Second; }
+int second() { return second(now()); }
+int day(time_t t) { return now_elements(t).Day; }
+int day() { return day(now()); }
+int weekday() { return now_elements(now()).Wday; }
+int month(time_t t) { return now_elements(t).Month; }
+int month() { return month(now()); }
+int year(time_t t) { return tmYearToCalendar(now_elements(t).Year); }
+int year() { return year(now()); }
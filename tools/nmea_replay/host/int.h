@@ -0,0 +1,4 @@
+/*
+   int.h - Host stand-in, the integer types come from <stdint.h>
+*/
+#include <stdint.h>
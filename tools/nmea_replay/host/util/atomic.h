@@ -0,0 +1,7 @@
+/* util/atomic.h - Host stand-in, there is nothing to protect on the host */
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (int __todo = 1; __todo; __todo = 0)
+#endif
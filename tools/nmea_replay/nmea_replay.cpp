@@ -0,0 +1,350 @@
+/*
+   nmea_replay.cpp - Replay recorded NMEA logs through the firmware's GPS and telemetry path on Linux.
+
+   The sketch itself is compiled for the host with the stand-ins in host/ for the Arduino core,
+   the serial ports and the Time library. The NMEA log is fed to the GPS port and time is simulated:
+   characters arrive at the GPS baud rate and every new UTC second in the log starts a new epoch,
+   so the firmware sees the same timing it would see in flight, only as fast as the host can go.
+   gps_fix(), get_telemetry_data() and set_tx_data() are the firmware's own, so is NeoGPS.
+
+   For every slot (every even minute of GPS time) the harness reports the encoded WSPR fields and
+   which telemetry fields fell back to the last valid value. It also reports the fix validity
+   transitions and, at the end, the parse throughput on the host.
+
+   Build, from the top of the repository, with NeoGPS (https://github.com/SlashDevin/NeoGPS) checked
+   out in $NEOGPS. NeoGPS must be configured like for the firmware, see the notes in GeminiWspr.ino:
+
+     g++ -std=gnu++11 -O2 -Itools/nmea_replay/host -I. -I$NEOGPS/src \
+         tools/nmea_replay/nmea_replay.cpp tools/nmea_replay/host/host.cpp Gemini*.cpp $NEOGPS/src/*.cpp \
+         -o nmea_replay
+
+   Usage:
+
+     nmea_replay [-b baud] [-r rate] [-t timeout_ms] [-a adc] [-c temp_c] [-e dump_file] [-l] flight.nmea
+
+     -b  GPS baud rate used to time the characters, default GPS_SERIAL_BAUD
+     -r  Pacing, 0 as fast as possible (default), 1 real time, 10 ten times real time...
+     -t  gps_fix() timeout for each call, default 1500 ms
+     -a  Value read by the ADC on every channel (battery voltage and temperatures), default 512
+     -c  DS18B20 temperature, default 20 C
+     -e  Write the flight recorder dump to dump_file at the end, for tools/recorder_decode
+     -l  Show the firmware's own serial output
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <time.h>
+#include <unistd.h>
+
+// The Arduino builder generates prototypes for the sketch, we have to provide the ones it relies on
+unsigned int seconds_to_next_slot();
+void wspr_tx_interrupt_setup();
+
+#include "../../GeminiWspr.ino"
+
+#define REPLAY_MAX_EPOCH_GAP_S  3600   // Larger jumps in the log time are treated as a discontinuity
+
+// ------- Replayed GPS port -------
+
+static char *g_log = NULL;
+static size_t g_log_len = 0;
+static size_t g_log_pos = 0;
+static uint64_t g_char_us = 0;         // Time to send one character at the GPS baud rate
+static uint64_t g_next_char_us = 0;    // Arrival time of g_log[g_log_pos]
+static uint64_t g_epoch_us = 0;        // Arrival time of the current epoch
+static long g_epoch_tod = -1;          // UTC second of day of the current epoch
+
+// UTC second of day of the sentence starting at p, -1 if it doesn't carry the time in field 1
+static long sentence_time_of_day(const char *p, size_t len) {
+  int i;
+
+  if ((len < 14) || (p[0] != '$') || (p[6] != ',')) return -1;
+  if ((strncmp(p + 3, "RMC", 3) != 0) && (strncmp(p + 3, "GGA", 3) != 0) &&
+      (strncmp(p + 3, "ZDA", 3) != 0) && (strncmp(p + 3, "GNS", 3) != 0)) return -1;
+  for (i = 7; i < 13; i++)
+    if ((p[i] < '0') || (p[i] > '9')) return -1;
+  return ((p[7] - '0') * 10 + (p[8] - '0')) * 3600L + ((p[9] - '0') * 10 + (p[10] - '0')) * 60L +
+         (p[11] - '0') * 10 + (p[12] - '0');
+}
+
+// A new UTC second at the start of a line means the receiver starts a new burst
+static void schedule_line() {
+  long tod, delta;
+
+  if ((g_log_pos >= g_log_len) || ((g_log_pos > 0) && (g_log[g_log_pos - 1] != '\n'))) return;
+
+  tod = sentence_time_of_day(g_log + g_log_pos, g_log_len - g_log_pos);
+  if ((tod < 0) || (tod == g_epoch_tod)) return;
+
+  if (g_epoch_tod >= 0) {
+    delta = (tod - g_epoch_tod + 86400L) % 86400L;
+    if (delta > REPLAY_MAX_EPOCH_GAP_S) delta = 1;
+    g_epoch_us += delta * 1000000ULL;
+  }
+  else
+    g_epoch_us = g_next_char_us;
+  g_epoch_tod = tod;
+
+  if (g_next_char_us < g_epoch_us) g_next_char_us = g_epoch_us;
+}
+
+// Work out when the character at g_log_pos arrives
+static void schedule_next_char() {
+  g_next_char_us += g_char_us;
+  schedule_line();
+}
+
+static bool replay_done() {
+  return g_log_pos >= g_log_len;
+}
+
+int host_gps_available() {
+  if (replay_done()) {
+    host_advance_us(1000); // Let the firmware's timeouts run out
+    return 0;
+  }
+  if (g_next_char_us <= g_host_us) return 1;
+
+  // Nothing yet. Time goes by while the firmware polls, in steps small enough for its timeouts.
+  host_advance_us(min(g_next_char_us - g_host_us, (uint64_t)1000));
+  return 0;
+}
+
+int host_gps_peek() {
+  return replay_done() ? -1 : (uint8_t)g_log[g_log_pos];
+}
+
+int host_gps_read() {
+  int c;
+
+  if (replay_done()) return -1;
+  if (g_next_char_us > g_host_us) host_advance_us(g_next_char_us - g_host_us);
+  c = (uint8_t)g_log[g_log_pos++];
+  schedule_next_char();
+  return c;
+}
+
+static bool load_log(const char *path) {
+  FILE *f = fopen(path, "rb");
+  long size;
+
+  if (f == NULL) return false;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  g_log = (char *)malloc(size + 1);
+  g_log_len = fread(g_log, 1, size, f);
+  fclose(f);
+
+  g_log_pos = 0;
+  g_next_char_us = 0;
+  g_epoch_tod = -1;
+  schedule_line();
+  return true;
+}
+
+// ------- Reporting -------
+
+enum ReplayField {FIELD_LOCATION, FIELD_ALTITUDE, FIELD_SPEED, FIELD_SATELLITES, FIELD_STATUS, FIELD_COUNT};
+static const char *g_field_names[FIELD_COUNT] = {"location", "altitude", "speed", "satellites", "status"};
+static_assert((int)FIELD_STATUS == (int)TELEM_FIELDS, "The fields before the status are the snapshot's TelemetryField");
+
+static bool g_valid[FIELD_COUNT];
+static unsigned long g_transitions[FIELD_COUNT];
+static unsigned long g_fallbacks[FIELD_COUNT];
+
+static void current_validity(bool *valid) {
+  valid[FIELD_LOCATION] = fix.valid.location;
+  valid[FIELD_ALTITUDE] = fix.valid.altitude;
+  valid[FIELD_SPEED] = fix.valid.speed;
+  valid[FIELD_SATELLITES] = fix.valid.satellites;
+  valid[FIELD_STATUS] = fix.valid.status;
+}
+
+static void print_timestamp() {
+  printf("[%9.3f s] ", g_host_us / 1e6);
+  if (timeStatus() == timeSet)
+    printf("%04d-%02d-%02d %02d:%02d:%02d ", year(), month(), day(), hour(), minute(), second());
+  else
+    printf("--------- --:--:-- ");
+}
+
+static void report_transitions() {
+  bool valid[FIELD_COUNT];
+  int i;
+
+  current_validity(valid);
+  for (i = 0; i < FIELD_COUNT; i++) {
+    if (valid[i] == g_valid[i]) continue;
+    print_timestamp();
+    printf("%s %s\n", g_field_names[i], valid[i] ? "valid" : "lost");
+    g_transitions[i]++;
+    g_valid[i] = valid[i];
+  }
+}
+
+static void report_slot(bool cw) {
+  uint8_t msg_type;
+  uint32_t age_s;
+  int i;
+
+  msg_type = prepare_telemetry(cw ? 0 : minute());
+
+  print_timestamp();
+  printf("slot %s msg:%u call:%s grid:%s dbm:%u freq:%lu | grid6:%s alt:%ld m spd:%lu kn sats:%u temp:%d C volt_x10:%u",
+         cw ? "CW" : "WSPR", msg_type, g_beacon_callsign, g_grid_loc, g_tx_pwr_dbm, g_beacon_freq_hz,
+         g_telemetry.grid_sq_6char, (long)(g_telemetry.altitude_cm / 100), (unsigned long)(g_telemetry.speed_mkn / 1000),
+         g_telemetry.number_of_sats, g_telemetry.temperature_c, g_telemetry.battery_voltage_v_x10);
+
+  // get_telemetry_data() keeps the last valid value of every field that isn't valid in the current fix
+  for (i = 0; i < TELEM_FIELDS; i++) {
+    if (g_telemetry.valid & TELEM_VALID(i)) continue;
+    g_fallbacks[i]++;
+    age_s = telemetry_age_s(&g_telemetry, i);
+    if (age_s == TELEM_AGE_UNKNOWN)
+      printf(" last_valid:%s", g_field_names[i]);
+    else
+      printf(" last_valid:%s(%lus)", g_field_names[i], (unsigned long)age_s);
+  }
+  printf("\n");
+}
+
+static double wall_clock_s() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: nmea_replay [-b baud] [-r rate] [-t timeout_ms] [-a adc] [-c temp_c] [-e dump_file] [-l] flight.nmea\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long baud = GPS_SERIAL_BAUD;
+  unsigned long fix_timeout_ms = 1500;
+  unsigned long fixes = 0, timeouts = 0, slots = 0, cw_slots = 0;
+  uint64_t last_poll_us = 0;
+  long last_slot = -1;
+  long slot;
+  double wall_s;
+  const char *dump_file = NULL;
+  int opt;
+  int i;
+
+  while ((opt = getopt(argc, argv, "b:r:t:a:c:e:l")) != -1) {
+    switch (opt) {
+      case 'b' : baud = strtoul(optarg, NULL, 10); break;
+      case 'r' : g_host_rate = atof(optarg); break;
+      case 't' : fix_timeout_ms = strtoul(optarg, NULL, 10); break;
+      case 'a' : g_host_analog = atoi(optarg); break;
+      case 'c' : g_host_temperature_c = atof(optarg); break;
+      case 'e' : dump_file = optarg; break;
+      case 'l' : g_host_log = stdout; break;
+      default : usage();
+    }
+  }
+  if ((optind != argc - 1) || (baud == 0)) usage();
+
+  g_char_us = 10000000ULL / baud; // 8N1
+  if (!load_log(argv[optind])) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  h_chrono.start();
+  adc_begin(); // Battery and temperature readings from -a
+#if defined (DS1820_TEMP_SENSOR_PRESENT)
+  ds1820_begin(); // Reads -c
+#endif
+#if defined (FLIGHT_RECORDER)
+  recorder_begin();
+#endif
+  wall_s = wall_clock_s();
+
+  while (!replay_done()) {
+    if (gps_fix(fix_timeout_ms) == 0)
+      fixes++;
+    else
+      timeouts++;
+
+    report_transitions();
+
+#if defined (FLIGHT_RECORDER)
+    while (g_host_us - last_poll_us >= 3400) { // One EEPROM byte each 3.4 ms at most, like the hardware
+      recorder_poll();
+      last_poll_us += 3400;
+    }
+#endif
+
+    if (timeStatus() != timeSet) continue;
+#if defined (DS1820_TEMP_SENSOR_PRESENT)
+    ds1820_poll(seconds_to_next_slot());
+#endif
+
+    // Every even minute is a slot, CW on minutes 0 and 30 like in gemini_scheduler()
+    slot = now() / 120;
+    if (last_slot < 0) {
+      last_slot = slot; // Don't report the slot already in progress when the time was first set
+      continue;
+    }
+    if (slot == last_slot) continue;
+    last_slot = slot;
+
+    slots++;
+    if ((minute() == 0) || (minute() == 30)) cw_slots++;
+    report_slot((minute() == 0) || (minute() == 30));
+  }
+
+  serial_monitor_flush(); // The logs still in the queue, before the summary
+  wall_s = wall_clock_s() - wall_s;
+  if (wall_s <= 0) wall_s = 1e-9;
+
+  printf("\nreplay: %lu chars in %.1f s of GPS time, %.3f s on the host (%.0f chars/s)\n",
+         (unsigned long)g_log_len, g_host_us / 1e6, wall_s, g_log_len / wall_s);
+#if defined (NMEAGPS_STATS)
+  printf("nmea: ok:%lu err:%lu (%.0f sentences/s)\n", (unsigned long)gps.statistics.ok,
+         (unsigned long)gps.statistics.errors, gps.statistics.ok / wall_s);
+#endif
+  printf("gps_fix: %lu fixes, %lu timeouts\n", fixes, timeouts);
+  printf("monitor: %u messages dropped\n", serial_monitor_dropped());
+  printf("transitions:");
+  for (i = 0; i < FIELD_COUNT; i++) printf(" %s:%lu", g_field_names[i], g_transitions[i]);
+  printf("\nslots: %lu (WSPR %lu, CW %lu), last valid used:", slots, slots - cw_slots, cw_slots);
+  for (i = 0; i < FIELD_COUNT - 1; i++) printf(" %s:%lu", g_field_names[i], g_fallbacks[i]);
+  printf("\n");
+
+  if (dump_file != NULL) {
+#if defined (FLIGHT_RECORDER)
+    FILE *f = fopen(dump_file, "w");
+
+    if (f == NULL) {
+      perror(dump_file);
+      return 1;
+    }
+    g_host_log = f; // recorder_dump() prints through the serial monitor
+    recorder_dump();
+    serial_monitor_flush();
+    fclose(f);
+#else
+    fprintf(stderr, "%s not written, FLIGHT_RECORDER is not defined\n", dump_file);
+    return 1;
+#endif
+  }
+  return 0;
+}
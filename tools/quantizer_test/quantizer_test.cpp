@@ -0,0 +1,285 @@
+/*
+   quantizer_test.cpp - Check the table driven telemetry quantizers against the switches they replaced.
+
+   The case-range switch encoders as they were before GeminiQuantizer.h are kept below as the reference and
+   compared with the firmware's encode_altitude(), encode_solar_voltage_sats(), encode_battery_voltage() and
+   encode_temperature() for every input:
+
+     altitude     every int16_t, the AVR int, then well beyond it both ways since int is 32 bits here
+     temperature  every int8_t
+     battery      0 to 127, above that the old switch left the result uninitialised, the top bucket now
+     sats         0 to 127, above that the old switch had no return, the top bucket now
+
+   Prints the number of inputs checked and each mismatch, exits with 1 if there is any.
+
+   Build and run, from the top of the repository:
+
+     g++ -std=gnu++11 -O2 -Itools/nmea_replay/host -I. tools/quantizer_test/quantizer_test.cpp \
+         GeminiTelemetry.cpp GeminiAdc.cpp tools/nmea_replay/host/host.cpp -o quantizer_test
+     ./quantizer_test
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <limits.h>
+#include "HostSim.h"
+#include "GeminiTelemetry.h"
+
+// No GPS here, host.cpp wants these for the GPS port
+int host_gps_available() {
+  return 0;
+}
+
+int host_gps_read() {
+  return -1;
+}
+
+int host_gps_peek() {
+  return -1;
+}
+
+// The encoders as they were, only renamed
+
+static uint8_t reference_encode_altitude(int altitude_m) {
+  uint8_t ret_value = 0;
+ 
+  switch (altitude_m) { 
+    
+    case 0 ... 999 :
+      ret_value = 0;
+      break;
+
+    case 1000 ... 1999 :
+      ret_value = 3;
+      break;
+
+    case 2000 ... 2999 :
+      ret_value = 7;
+      break;
+
+    case 3000 ... 3999 :
+      ret_value = 10;
+      break;
+
+    case 4000 ... 4999 :
+      ret_value = 13;
+      break;
+
+    case 5000 ... 5999 :
+      ret_value = 17;
+      break;
+
+    case 6000 ... 6999 :
+      ret_value = 20;
+      break;
+
+    case 7000 ... 7999 :
+      ret_value = 23;
+      break;
+
+    case 8000 ... 8999 :
+      ret_value = 27;
+      break;
+
+    case 9000 ... 9999 :
+      ret_value = 30;
+      break;
+
+    case 10000 ... 10999 :
+      ret_value = 33;
+      break;
+
+    case 11000 ... 11999 :
+      ret_value = 37;
+      break;
+
+    case 12000 ... 12999 :
+      ret_value = 40;
+      break;
+
+    case 13000 ... 13999 :
+      ret_value = 43;
+      break;
+
+    case 14000 ... 14999 :
+      ret_value = 47;
+      break;
+
+    case 15000 ... 15999 :
+      ret_value = 50;
+      break;
+
+    case 16000 ... 16999 :
+      ret_value = 53;
+      break;
+
+    case 17000 ... 17999 :
+      ret_value = 57;
+      break;
+
+    default : //  >= 18000 metres
+      ret_value = 60;
+      break;
+  }
+  return ret_value;
+}
+
+static int reference_encode_solar_voltage_sats(uint8_t number_of_sats) {
+  switch (number_of_sats) {
+    case 0 ... 3 :
+      return 0;
+      break;
+    case 4 ... 7 :
+      return 1;
+      break;
+    case 8 ... INT8_MAX :
+      return 2;
+      break;
+  }
+  return -1; // Fell out of the switch, no return at all in the original
+}
+
+static char reference_encode_battery_voltage(uint8_t battery_voltage) {
+  uint8_t encoded_voltage;
+
+  switch (battery_voltage) {
+    case 0 ... 30 :
+      encoded_voltage = 0;
+      break;
+    case 31 ... 32 :
+      encoded_voltage = 1;
+      break;
+    case 33 ... 34 :
+      encoded_voltage = 2;
+      break;
+    case 35 ... 36 :
+      encoded_voltage = 3;
+      break;
+    case 37 ... 38 :
+      encoded_voltage = 4;
+      break;
+    case 39 ... 40 :
+      encoded_voltage = 5;
+      break;
+    case 41 ... 42 :
+      encoded_voltage = 6;
+      break;
+    case 43 ... 44 :
+      encoded_voltage = 7;
+      break;
+    case 45 ... 46 :
+      encoded_voltage = 8;
+      break;
+    case 47 ... 48 :
+      encoded_voltage = 9;
+      break;
+    case 49 ... 50 :
+      encoded_voltage = 10;
+      break;
+    case 51 ... INT8_MAX :
+      encoded_voltage = 11;
+      break;
+  }
+  return encoded_voltage + 'A';
+}
+
+static char reference_encode_temperature(int8_t temperature_c) {
+  char ret_value;
+
+  switch ( temperature_c ){
+  
+    case INT8_MIN ... -35:
+      ret_value = (char)0;
+      break;
+
+    case -34 ... -30:
+      ret_value = (char)1;
+      break;
+
+    case -29 ... -25:
+      ret_value = (char)2;
+      break;
+
+    case -24 ... -20:
+      ret_value = (char)3;
+      break;
+
+    case -19 ... -15:
+      ret_value = (char)4;
+      break;
+
+    case -14 ... -10:
+      ret_value = (char)5;
+      break;
+
+    case -9 ... -5:
+      ret_value = (char)6;
+      break;
+
+    case -4 ... 0:
+      ret_value = (char)7;
+      break;
+
+    case 1 ... 5:
+      ret_value = (char)8;
+      break;
+    
+    default:
+      ret_value = (char)9;
+    break;
+  }
+  return ret_value + 'A';
+}
+
+static unsigned long g_checked = 0;
+static unsigned long g_mismatches = 0;
+
+static void check(const char *name, long input, int expected, int actual) {
+  g_checked++;
+  if (expected == actual) return;
+  g_mismatches++;
+  printf("%s(%ld): expected %d got %d\n", name, input, expected, actual);
+}
+
+int main() {
+  long v;
+
+  for (v = INT16_MIN; v <= INT16_MAX; v++)
+    check("encode_altitude", v, reference_encode_altitude(v), encode_altitude(v));
+  // A 32 bit int can't be cast to int16_t on the way to the table, 65536 + 5000 m is not 5000 m
+  for (v = INT16_MAX + 1L; v <= 200000L; v++)
+    check("encode_altitude", v, reference_encode_altitude(v), encode_altitude(v));
+  for (v = -200000L; v < INT16_MIN; v++)
+    check("encode_altitude", v, reference_encode_altitude(v), encode_altitude(v));
+  check("encode_altitude", INT_MAX, reference_encode_altitude(INT_MAX), encode_altitude(INT_MAX));
+  check("encode_altitude", INT_MIN, reference_encode_altitude(INT_MIN), encode_altitude(INT_MIN));
+
+  for (v = INT8_MIN; v <= INT8_MAX; v++)
+    check("encode_temperature", v, reference_encode_temperature(v), encode_temperature(v));
+
+  for (v = 0; v <= INT8_MAX; v++) {
+    check("encode_battery_voltage", v, reference_encode_battery_voltage(v), encode_battery_voltage(v));
+    check("encode_solar_voltage_sats", v, reference_encode_solar_voltage_sats(v), encode_solar_voltage_sats(0, v));
+  }
+  for (v = INT8_MAX + 1; v <= UINT8_MAX; v++) {
+    check("encode_battery_voltage", v, 'L', encode_battery_voltage(v));
+    check("encode_solar_voltage_sats", v, 2, encode_solar_voltage_sats(0, v));
+  }
+
+  printf("%lu inputs checked, %lu mismatches\n", g_checked, g_mismatches);
+  return (g_mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/*
+   recorder_decode.cpp - Decode a flight recorder dump into a CSV flight profile.
+
+   recorder_dump() prints a header line and the recorder as hex, 32 bytes a line:
+
+     REC v1 blocks:4 size:152
+     REC 0000 4101004E...
+     REC 0020 ...
+
+   Any other line of the serial capture is ignored. The blocks are put back in the order they were
+   written using their sequence numbers and every sample is printed as a CSV line, oldest first.
+   See GeminiRecorder.cpp for the encoding.
+
+   Build and run:
+
+     g++ -std=gnu++11 -O2 tools/recorder_decode/recorder_decode.cpp -o recorder_decode
+     ./recorder_decode [capture.txt]       (standard input without a file)
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#define RECORDER_VERSION   1
+#define RECORDER_TAG_KEY   0x40
+#define RECORDER_TAG_END   0xFF
+
+struct Sample {
+  uint32_t time;
+  int32_t latitude_e5;
+  int32_t longitude_e5;
+  int32_t altitude_m;
+  int32_t temperature_c;
+  int32_t battery_voltage_v_x10;
+  int32_t number_of_sats;
+  int32_t cal_factor;
+};
+
+struct Block {
+  unsigned index;
+  uint16_t sequence;
+};
+
+// Reads a variable length integer, false if it runs past the end of the block
+static bool get_varint(const uint8_t *block, unsigned size, unsigned *pos, uint32_t *value) {
+  unsigned shift = 0;
+  uint8_t byte;
+
+  *value = 0;
+  do {
+    if ((*pos >= size) || (shift > 28)) return false;
+    byte = block[(*pos)++];
+    *value |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return true;
+}
+
+static bool get_signed(const uint8_t *block, unsigned size, unsigned *pos, int32_t *value) {
+  uint32_t zigzag;
+
+  if (!get_varint(block, size, pos, &zigzag)) return false;
+  *value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+  return true;
+}
+
+static void print_sample(uint16_t sequence, uint8_t tag, const struct Sample *s) {
+  char when[24];
+  time_t t = s->time;
+  struct tm *tm = gmtime(&t);
+
+  strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", tm);
+  printf("%u,%s,%.5f,%.5f,%ld,%ld,%.1f,%ld,%ld,%s%s%s%s\n", sequence, when, s->latitude_e5 / 1e5,
+         s->longitude_e5 / 1e5, (long)s->altitude_m, (long)s->temperature_c, s->battery_voltage_v_x10 / 10.0,
+         (long)s->number_of_sats, (long)s->cal_factor,
+         (tag & 0x01) ? "P" : "-", (tag & 0x02) ? "A" : "-", (tag & 0x04) ? "S" : "-", (tag & 0x08) ? "N" : "-");
+}
+
+// Prints every sample of a block, returns how many there were
+static unsigned decode_block(const uint8_t *block, unsigned size) {
+  struct Sample s;
+  unsigned pos = 0, samples = 0;
+  uint16_t sequence = 0;
+  uint32_t u;
+  int32_t d[7];
+  uint8_t tag;
+  int i;
+
+  memset(&s, 0, sizeof(s));
+  while ((pos < size) && (block[pos] != RECORDER_TAG_END)) {
+    tag = block[pos++];
+    if (tag & 0x80) break;
+    if (samples == 0) {
+      if (!(tag & RECORDER_TAG_KEY) || (pos + 2 > size)) break;
+      sequence = block[pos] | (block[pos + 1] << 8);
+      pos += 2;
+    }
+
+    if (!get_varint(block, size, &pos, &u)) break;
+    for (i = 0; i < 7; i++)
+      if (!get_signed(block, size, &pos, &d[i])) break;
+    if (i < 7) {
+      fprintf(stderr, "block %u: sample %u is cut short\n", sequence, samples);
+      break;
+    }
+
+    s.time += u;
+    s.latitude_e5 += d[0];
+    s.longitude_e5 += d[1];
+    s.altitude_m += d[2];
+    s.temperature_c += d[3];
+    s.battery_voltage_v_x10 += d[4];
+    s.number_of_sats += d[5];
+    s.cal_factor += d[6];
+    print_sample(sequence, tag, &s);
+    samples++;
+  }
+  return samples;
+}
+
+int main(int argc, char *argv[]) {
+  FILE *f = stdin;
+  char line[256];
+  unsigned version = 0, blocks = 0, size = 0, offset, i, samples = 0;
+  std::vector<uint8_t> recorder;
+  std::vector<struct Block> written;
+  struct Block b;
+  char *p;
+
+  if (argc > 2) {
+    fprintf(stderr, "usage: recorder_decode [capture.txt]\n");
+    return 2;
+  }
+  if ((argc == 2) && ((f = fopen(argv[1], "r")) == NULL)) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    p = strstr(line, "REC ");
+    if (p == NULL) continue;
+    if (sscanf(p, "REC v%u blocks:%u size:%u", &version, &blocks, &size) == 3) {
+      recorder.assign(blocks * size, RECORDER_TAG_END);
+      continue;
+    }
+    if (recorder.empty() || (sscanf(p, "REC %x", &offset) != 1)) continue;
+
+    // The hex starts after the offset
+    p += 9;
+    while ((p[0] != '\0') && (p[1] != '\0') && (offset < recorder.size())) {
+      if (sscanf(p, "%2x", &i) != 1) break;
+      recorder[offset++] = (uint8_t)i;
+      p += 2;
+    }
+  }
+  if (f != stdin) fclose(f);
+
+  if (recorder.empty()) {
+    fprintf(stderr, "No recorder dump found\n");
+    return 1;
+  }
+  if (version != RECORDER_VERSION) {
+    fprintf(stderr, "Recorder version %u, this decoder knows version %u\n", version, RECORDER_VERSION);
+    return 1;
+  }
+
+  // Blocks in the order they were written, the sequence number wraps
+  for (i = 0; i < blocks; i++) {
+    if ((recorder[i * size] & 0xC0) != RECORDER_TAG_KEY) continue;
+    b.index = i;
+    b.sequence = recorder[i * size + 1] | (recorder[i * size + 2] << 8);
+    written.push_back(b);
+  }
+  if (written.empty()) {
+    fprintf(stderr, "The recorder is empty\n");
+    return 0;
+  }
+  uint16_t newest = written[0].sequence;
+  for (i = 1; i < written.size(); i++)
+    if ((int16_t)(written[i].sequence - newest) > 0) newest = written[i].sequence;
+  std::sort(written.begin(), written.end(), [newest](const struct Block &x, const struct Block &y) {
+    return (uint16_t)(newest - x.sequence) > (uint16_t)(newest - y.sequence);
+  });
+
+  printf("block,time_utc,latitude,longitude,altitude_m,temperature_c,battery_v,sats,cal_ppb,valid\n");
+  for (i = 0; i < written.size(); i++) samples += decode_block(&recorder[written[i].index * size], size);
+  fprintf(stderr, "%u samples in %u blocks\n", samples, (unsigned)written.size());
+  return 0;
+}
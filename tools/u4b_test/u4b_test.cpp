@@ -0,0 +1,119 @@
+/*
+   u4b_test.cpp - Check the U4B basic telemetry encoders against fixed vectors.
+
+   encode_u4b_callsign() and encode_u4b_grid_power() are run on a few positions and readings whose
+   U4B callsign, grid and power were worked out by hand from the published encoding (see the U4B and
+   Traquito documentation), and on the edges where each value is clamped. Each vector that doesn't
+   match is printed, the exit status is 1 if there is any.
+
+   Build and run, from the top of the repository:
+
+     g++ -std=gnu++11 -O2 -Itools/nmea_replay/host -I. tools/u4b_test/u4b_test.cpp \
+         GeminiTelemetry.cpp GeminiAdc.cpp tools/nmea_replay/host/host.cpp -o u4b_test
+     ./u4b_test
+
+   Heavily based on OrionWspr by Michael Babineau, VE3WMB - https://github.com/ve3wmb/OrionWspr
+   Copyright 2019 Alain De Carolis, K1FM <alain@alain.it>
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <string.h>
+#include "HostSim.h"
+#include "GeminiTelemetry.h"
+
+// No GPS here, host.cpp wants these for the GPS port
+int host_gps_available() {
+  return 0;
+}
+
+int host_gps_read() {
+  return -1;
+}
+
+int host_gps_peek() {
+  return -1;
+}
+
+struct CallsignVector {
+  char id1, id3;
+  const char *grid_sq_6char;
+  int32_t altitude_m;
+  const char *callsign;
+};
+
+// (subsquare longitude * 24 + subsquare latitude) * 1068 + altitude / 20, in base 26 for the last three
+// letters and base 36 for the second character
+static const struct CallsignVector g_callsign_vectors[] = {
+  {'Q', '1', "FN42AA", 0, "Q01AAA"},          // Everything zero
+  {'Q', '1', "FN31PR", 12000, "QM1YNC"},      // 15, 17 and 600: 403236
+  {'0', '9', "JO22XX", 21340, "0Z9AAH"},      // The top of every value: 23, 23 and 1067, 615167
+  {'0', '9', "JO22XX", 30000, "0Z9AAH"},      // Above 21340 m is 21340 m
+  {'1', '5', "FN42AA", -500, "105AAA"},       // Below 0 m is 0 m
+  {'1', '5', "FN42AA", 29, "105AAB"},         // Rounded to the nearest 20 m
+  {'1', '5', "FN42AA", 30, "105AAC"},
+};
+
+struct GridPowerVector {
+  int temperature_c;
+  uint16_t voltage_mv;
+  uint32_t speed_kn;
+  bool gps_valid;
+  const char *grid;
+  uint8_t power_dbm;
+};
+
+// (((temperature + 50) * 40 + voltage) * 42 + speed / 2) * 4 + gps valid * 2 + 1, the power is the remainder
+// by 19 then two digits and two letters of 18. The voltage is (steps of 0.05 V above 3.00 V + 20) % 40.
+static const struct GridPowerVector g_grid_power_vectors[] = {
+  {-20, 3300, 40, true, "GA44", 50},          // 30, 26, 20 and 1: 206051
+  {39, 4950, 82, true, "RK54", 43},           // The top of every value: 89, 19, 41 and 1, 601439
+  {45, 5500, 200, true, "RK54", 43},          // Clamped to the top
+  {-50, 3000, 0, false, "AB76", 57},          // The bottom: 0, 20, 0 and 0, 3361
+  {-80, 2500, 0, false, "AB76", 57},          // Clamped to the bottom
+};
+
+int main() {
+  char callsign[7];
+  char grid[5];
+  uint8_t power, i;
+  unsigned int failures = 0;
+
+  for (i = 0; i < sizeof(g_callsign_vectors) / sizeof(g_callsign_vectors[0]); i++) {
+    const struct CallsignVector *v = &g_callsign_vectors[i];
+
+    encode_u4b_callsign(callsign, v->id1, v->id3, v->grid_sq_6char, v->altitude_m);
+    if (strcmp(callsign, v->callsign) != 0) {
+      printf("encode_u4b_callsign(%c, %c, %s, %ld): expected %s got %s\n", v->id1, v->id3, v->grid_sq_6char,
+             (long)v->altitude_m, v->callsign, callsign);
+      failures++;
+    }
+  }
+
+  for (i = 0; i < sizeof(g_grid_power_vectors) / sizeof(g_grid_power_vectors[0]); i++) {
+    const struct GridPowerVector *v = &g_grid_power_vectors[i];
+
+    power = encode_u4b_grid_power(grid, v->temperature_c, v->voltage_mv, v->speed_kn, v->gps_valid);
+    if ((strcmp(grid, v->grid) != 0) || (power != v->power_dbm)) {
+      printf("encode_u4b_grid_power(%d, %u, %lu, %d): expected %s %u got %s %u\n", v->temperature_c,
+             v->voltage_mv, (unsigned long)v->speed_kn, v->gps_valid, v->grid, v->power_dbm, grid, power);
+      failures++;
+    }
+  }
+
+  printf("%u callsign and %u grid and power vectors, %u failures\n",
+         (unsigned int)(sizeof(g_callsign_vectors) / sizeof(g_callsign_vectors[0])),
+         (unsigned int)(sizeof(g_grid_power_vectors) / sizeof(g_grid_power_vectors[0])), failures);
+  return (failures == 0) ? 0 : 1;
+}